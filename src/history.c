@@ -0,0 +1,186 @@
+/* ========================================================================== */
+/* File: history.c
+ *
+ * A ring of per-day records in persistent storage, indexed by day number
+ * (days since the epoch). Each day packs into four bytes:
+ *
+ *   bits  0-15  points, which are steps, up to 65535
+ *   bit   16    goal met
+ *   bits 17-23  minutes worn / 15
+ *   bits 24-31  active minutes / 5
+ *
+ * so a 256 byte key holds HISTORY_DAYS_PER_KEY days and the default
+ * HISTORY_KEYS hold 512 days, about 17 months, in 2 KB. That is what the
+ * app's 4 KB of storage can spare beside the strap spool (see history.h);
+ * older days are dropped as new ones come in.
+ *
+ * A day lives at slot day % HISTORY_DAYS, so appending and looking up a
+ * day are both O(1), and a range sum reads each key it spans once. Days
+ * the app was not opened read as empty. The key being written or read is
+ * kept in memory and written back when a different key is needed, so a
+ * gap of several days costs one write per key it spans.
+ */
+/* ========================================================================== */
+// ---------------- Open Issues
+
+// ---------------- System includes e.g., <stdio.h>
+#include <pebble.h>
+
+// ---------------- Local includes  e.g., "file.h"
+#include "history.h"
+
+// ---------------- Constant definitions
+#define RECORD_SIZE 4
+#define HISTORY_VERSION 2 // 1 packed three bytes a day, with points / 8
+#define CHUNK_SIZE (HISTORY_DAYS_PER_KEY * RECORD_SIZE)
+#define NO_CHUNK 0xff
+
+// ---------------- Structures/Types
+
+// where the ring is; kept at the first key
+typedef struct {
+	uint16_t last_day;          // newest day appended
+	uint16_t days;              // days held, up to HISTORY_DAYS
+	uint16_t version;           // HISTORY_VERSION
+} HistoryMeta;
+
+// ---------------- Private variables
+
+static uint32_t base_key;
+static HistoryMeta meta;
+static uint8_t chunk[CHUNK_SIZE];
+static uint8_t chunk_index = NO_CHUNK;
+static bool chunk_dirty = false;
+
+// ---------------- Private prototypes
+static uint8_t *slot(uint16_t day);
+static void write_chunk(void);
+static void pack(uint8_t *bytes, const HistoryDay *record);
+static void unpack(const uint8_t *bytes, HistoryDay *record);
+static uint32_t quantize(uint32_t value, uint16_t unit, uint32_t max);
+
+/* ========================================================================== */
+
+void history_init(uint32_t key) {
+	base_key = key;
+	chunk_index = NO_CHUNK;
+	chunk_dirty = false;
+	// a ring in an older layout, which has a shorter meta, starts over
+	if ( persist_read_data(base_key, &meta, sizeof(meta)) != sizeof(meta)
+		|| meta.version != HISTORY_VERSION ) {
+		meta.last_day = 0;
+		meta.days = 0;
+		meta.version = HISTORY_VERSION;
+	}
+}
+
+// records a day. days skipped since the last one are cleared, and a day
+// that is already held is overwritten
+void history_append(uint16_t day, const HistoryDay *record) {
+	if ( meta.days && day + HISTORY_DAYS <= meta.last_day ) {
+		return; // older than anything the ring holds
+	}
+
+	if ( !meta.days || day > meta.last_day ) {
+		uint16_t gap = meta.days ? day - meta.last_day - 1 : 0;
+		if ( gap > HISTORY_DAYS ) {
+			gap = HISTORY_DAYS;
+		}
+		for (uint16_t d = day - gap; d < day; d++) {
+			memset(slot(d), 0, RECORD_SIZE);
+			chunk_dirty = true;
+		}
+
+		uint32_t days = (uint32_t) meta.days + gap + 1;
+		meta.days = days < HISTORY_DAYS ? days : HISTORY_DAYS;
+		meta.last_day = day;
+		persist_write_data(base_key, &meta, sizeof(meta));
+	}
+
+	pack(slot(day), record);
+	chunk_dirty = true;
+	write_chunk();
+}
+
+// fills record with a day. returns false for a day the ring does not hold
+bool history_get(uint16_t day, HistoryDay *record) {
+	if ( !meta.days || day > meta.last_day
+		|| day + meta.days <= meta.last_day ) {
+		memset(record, 0, sizeof(*record));
+		return false;
+	}
+	unpack(slot(day), record);
+	return true;
+}
+
+// totals for the days first to last, both included
+void history_sum(uint16_t first, uint16_t last, HistoryTotals *totals) {
+	HistoryDay record;
+
+	memset(totals, 0, sizeof(*totals));
+	for (uint32_t day = first; day <= last; day++) {
+		if ( history_get(day, &record) ) {
+			history_add(totals, &record);
+		}
+	}
+}
+
+void history_add(HistoryTotals *totals, const HistoryDay *record) {
+	if ( !record->minutes_worn && !record->points ) {
+		return;
+	}
+	totals->days++;
+	totals->goals += record->goal_met;
+	totals->points += record->points;
+	totals->minutes_worn += record->minutes_worn;
+	totals->active_minutes += record->active_minutes;
+}
+
+// the four bytes of a day, with its key loaded
+static uint8_t *slot(uint16_t day) {
+	uint16_t index = day % HISTORY_DAYS;
+	uint8_t key = index / HISTORY_DAYS_PER_KEY;
+
+	if ( key != chunk_index ) {
+		write_chunk();
+		memset(chunk, 0, CHUNK_SIZE);
+		persist_read_data(base_key + 1 + key, chunk, CHUNK_SIZE);
+		chunk_index = key;
+	}
+	return &chunk[(index % HISTORY_DAYS_PER_KEY) * RECORD_SIZE];
+}
+
+static void write_chunk(void) {
+	if ( chunk_index != NO_CHUNK && chunk_dirty ) {
+		persist_write_data(base_key + 1 + chunk_index, chunk, CHUNK_SIZE);
+	}
+	chunk_dirty = false;
+}
+
+static void pack(uint8_t *bytes, const HistoryDay *record) {
+	uint32_t packed = quantize(record->points, 1, 0xffff)
+		| (record->goal_met ? 1 << 16 : 0)
+		| quantize(record->minutes_worn, 15, 0x7f) << 17
+		| quantize(record->active_minutes, 5, 0xff) << 24;
+
+	bytes[0] = packed;
+	bytes[1] = packed >> 8;
+	bytes[2] = packed >> 16;
+	bytes[3] = packed >> 24;
+}
+
+static void unpack(const uint8_t *bytes, HistoryDay *record) {
+	uint32_t packed = bytes[0] | bytes[1] << 8 | (uint32_t) bytes[2] << 16
+		| (uint32_t) bytes[3] << 24;
+
+	record->points = packed & 0xffff;
+	record->goal_met = packed >> 16 & 1;
+	record->minutes_worn = (packed >> 17 & 0x7f) * 15;
+	record->active_minutes = (packed >> 24 & 0xff) * 5;
+}
+
+// rounds to the nearest unit, clamped to what the field holds
+static uint32_t quantize(uint32_t value, uint16_t unit, uint32_t max) {
+	uint32_t units = (value + unit / 2) / unit;
+	return units < max ? units : max;
+}
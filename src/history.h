@@ -0,0 +1,46 @@
+/* ========================================================================== */
+/* File: history.h
+ *
+ * The per-day history store; see history.c.
+ */
+/* ========================================================================== */
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <pebble.h>
+
+// keys holding day records, after the one that holds where the ring is.
+// The app has 4 KB of persistent storage and the strap spool takes 1.5 KB
+// of it, so the 3 KB of twelve keys, about two years, does not fit. Eight
+// reach 512 days back and leave some 400 bytes for keys added later.
+#ifndef HISTORY_KEYS
+#define HISTORY_KEYS 8
+#endif
+
+#define HISTORY_DAYS_PER_KEY 64   // four bytes a day, within 256 a key
+#define HISTORY_DAYS (HISTORY_KEYS * HISTORY_DAYS_PER_KEY)
+
+// one day, as it is given to the store. points are kept exactly up to
+// 65535, minutes worn to the nearest 15 and active minutes to the nearest 5
+typedef struct {
+	uint32_t points;
+	bool goal_met;
+	uint16_t minutes_worn;
+	uint16_t active_minutes;
+} HistoryDay;
+
+typedef struct {
+	uint16_t days;              // days in the range the watch was worn
+	uint16_t goals;
+	uint32_t points;
+	uint32_t minutes_worn;
+	uint32_t active_minutes;
+} HistoryTotals;
+
+void history_init(uint32_t key);
+void history_append(uint16_t day, const HistoryDay *record);
+bool history_get(uint16_t day, HistoryDay *record);
+void history_sum(uint16_t first, uint16_t last, HistoryTotals *totals);
+void history_add(HistoryTotals *totals, const HistoryDay *record);
+
+#endif
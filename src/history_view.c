@@ -0,0 +1,152 @@
+/* ========================================================================== */
+/* File: history_view.c
+ *
+ * Trends from the day history, on the watch: totals for the last week,
+ * the week before and the last 30 days, and a bar for each of the last
+ * seven days scaled to the goal. Today is taken from the live counters
+ * rather than the store, which only has it once the day is over.
+ */
+/* ========================================================================== */
+// ---------------- Open Issues
+
+// ---------------- System includes e.g., <stdio.h>
+#include <pebble.h>
+
+// ---------------- Local includes  e.g., "file.h"
+#include "history_view.h"
+
+// ---------------- Constant definitions
+#define WINDOW_HEIGHT 168
+#define WINDOW_WIDTH 144
+#define TEXT_HEIGHT 104
+#define BAR_DAYS 7
+#define BAR_GAP 2
+#define MAX_SUMMARY_LENGTH 160
+
+// ---------------- Private variables
+
+static Window *window = NULL;
+static TextLayer *summary_text;
+static Layer *bars_layer;
+static AppTimer *hide_timer = NULL;
+static char summary[MAX_SUMMARY_LENGTH];
+static uint8_t bar_heights[BAR_DAYS];    // oldest first, today last
+
+// ---------------- Private prototypes
+static void window_load(Window *window);
+static void window_unload(Window *window);
+static void bars_update(Layer *layer, GContext *ctx);
+static void hide_timeout(void *data);
+static void summarize(uint16_t today, const HistoryDay *live, int goal);
+
+/* ========================================================================== */
+
+// shows the view, or takes it down if it is already up
+void history_view_toggle(uint16_t today, const HistoryDay *live, int goal) {
+	if ( window && window_stack_contains_window(window) ) {
+		window_stack_remove(window, true);
+		return;
+	}
+
+	if ( !window ) {
+		window = window_create();
+		window_set_background_color(window, GColorBlack);
+		window_set_window_handlers(window, (WindowHandlers) {
+			.load = window_load,
+			.unload = window_unload,
+		});
+	}
+	summarize(today, live, goal);
+	window_stack_push(window, true);
+	hide_timer = app_timer_register(HISTORY_VIEW_MS, hide_timeout, NULL);
+}
+
+void history_view_destroy(void) {
+	if ( window ) {
+		window_destroy(window);
+		window = NULL;
+	}
+}
+
+// fills the summary and the bars from the store, plus today
+static void summarize(uint16_t today, const HistoryDay *live, int goal) {
+	HistoryTotals week, last_week, month;
+	HistoryDay day;
+
+	history_sum(today - 6, today - 1, &week);
+	history_add(&week, live);
+	history_sum(today - 13, today - 7, &last_week);
+	history_sum(today - 29, today - 1, &month);
+	history_add(&month, live);
+
+	snprintf(summary, MAX_SUMMARY_LENGTH, 
+		"7 days: %lu pts\ngoals %u/7, %lu active min\n"
+		"week before: %lu pts\n30 days: %lu pts\ngoals %u/30, %lu min/day worn", 
+		(unsigned long) week.points, week.goals, 
+		(unsigned long) week.active_minutes, 
+		(unsigned long) last_week.points, (unsigned long) month.points, 
+		month.goals, (unsigned long) (month.days ? 
+			month.minutes_worn / month.days : 0));
+
+	for (int i = 0; i < BAR_DAYS; i++) {
+		if ( i == BAR_DAYS - 1 ) {
+			day = *live;
+		} else {
+			history_get(today - (BAR_DAYS - 1 - i), &day);
+		}
+		int height = (WINDOW_HEIGHT - TEXT_HEIGHT) * day.points / goal;
+		bar_heights[i] = height < WINDOW_HEIGHT - TEXT_HEIGHT ? 
+			height : WINDOW_HEIGHT - TEXT_HEIGHT;
+	}
+}
+
+static void window_load(Window *window) {
+	Layer *window_layer = window_get_root_layer(window);
+
+	summary_text = text_layer_create((GRect) { 
+		.origin = { 0, 0 }, 
+		.size = { WINDOW_WIDTH, TEXT_HEIGHT } 
+	});
+	text_layer_set_background_color(summary_text, GColorBlack);
+	text_layer_set_text_color(summary_text, GColorWhite);
+	text_layer_set_font(summary_text, fonts_get_system_font(FONT_KEY_GOTHIC_14));
+	text_layer_set_text_alignment(summary_text, GTextAlignmentCenter);
+	text_layer_set_text(summary_text, summary);
+
+	bars_layer = layer_create((GRect) { 
+		.origin = { 0, TEXT_HEIGHT }, 
+		.size = { WINDOW_WIDTH, WINDOW_HEIGHT - TEXT_HEIGHT } 
+	});
+	layer_set_update_proc(bars_layer, bars_update);
+
+	layer_add_child(window_layer, text_layer_get_layer(summary_text));
+	layer_add_child(window_layer, bars_layer);
+}
+
+static void window_unload(Window *window) {
+	if ( hide_timer ) {
+		app_timer_cancel(hide_timer);
+		hide_timer = NULL;
+	}
+	text_layer_destroy(summary_text);
+	layer_destroy(bars_layer);
+}
+
+// one bar a day, growing up from the bottom of the window
+static void bars_update(Layer *layer, GContext *ctx) {
+	GRect bounds = layer_get_bounds(layer);
+	int width = bounds.size.w / BAR_DAYS;
+
+	graphics_context_set_fill_color(ctx, GColorWhite);
+	for (int i = 0; i < BAR_DAYS; i++) {
+		graphics_fill_rect(ctx, (GRect) { 
+			.origin = { i * width + BAR_GAP, bounds.size.h - bar_heights[i] }, 
+			.size = { width - 2 * BAR_GAP, bar_heights[i] } 
+		}, 0, GCornerNone);
+	}
+}
+
+static void hide_timeout(void *data) {
+	hide_timer = NULL;
+	window_stack_remove(window, true);
+}
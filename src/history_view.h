@@ -0,0 +1,19 @@
+/* ========================================================================== */
+/* File: history_view.h
+ *
+ * The trend view over the day history; see history_view.c.
+ */
+/* ========================================================================== */
+#ifndef HISTORY_VIEW_H
+#define HISTORY_VIEW_H
+
+#include <pebble.h>
+#include "history.h"
+
+// how long the view stays up before going back to the watchface
+#define HISTORY_VIEW_MS 10000
+
+void history_view_toggle(uint16_t today, const HistoryDay *live, int goal);
+void history_view_destroy(void);
+
+#endif
@@ -0,0 +1,166 @@
+/* ========================================================================== */
+/* File: journal.c
+ *
+ * Write-behind storage for a handful of counters. Changes are kept in
+ * memory and written together, so a burst of updates costs one flash
+ * write instead of one per update:
+ *
+ *   - JOURNAL_FLUSH_MS after the first unsaved change, or
+ *   - once JOURNAL_MAX_CHANGES are unsaved, if the last flush was at least
+ *     JOURNAL_MIN_MS ago, or
+ *   - when the caller asks, for changes that must not be lost.
+ *
+ * That bounds the writes to one a minute however busy the counters are,
+ * and a crash loses at most JOURNAL_FLUSH_MS of changes.
+ *
+ * All values are written as one record that alternates between two keys,
+ * key and key + 1. The record carries a sequence number and a checksum,
+ * and loading takes the valid record with the highest sequence, so a write
+ * cut short by a crash leaves the previous record to fall back on.
+ */
+/* ========================================================================== */
+// ---------------- Open Issues
+
+// ---------------- System includes e.g., <stdio.h>
+#include <pebble.h>
+
+// ---------------- Local includes  e.g., "file.h"
+#include "journal.h"
+
+// ---------------- Structures/Types
+
+typedef struct {
+	uint32_t seq;
+	int32_t values[JOURNAL_VALUES];
+	uint32_t check;
+} JournalRecord;
+
+// ---------------- Private variables
+
+static uint32_t base_key;
+static JournalRecord record;       // the values as they are now
+static uint16_t unsaved;           // changes since the last flush
+static uint64_t unsaved_since;
+static uint64_t last_flush;
+static AppTimer *flush_timer = NULL;
+static JournalStats stats;
+
+// ---------------- Private prototypes
+static uint64_t clock_ms(void);
+static uint32_t checksum(const JournalRecord *r);
+static bool read_slot(uint8_t slot, JournalRecord *r);
+static void flush_timeout(void *data);
+
+/* ========================================================================== */
+
+void journal_init(uint32_t key) {
+	base_key = key;
+	memset(&record, 0, sizeof(record));
+	memset(&stats, 0, sizeof(stats));
+	unsaved = 0;
+	last_flush = 0;
+}
+
+// fills values from the newest valid record. returns false if there is
+// none, leaving values alone so the caller's defaults stand
+bool journal_load(int32_t *values, uint8_t count) {
+	if ( count > JOURNAL_VALUES ) {
+		APP_LOG(APP_LOG_LEVEL_ERROR, "journal: %u values asked for, %d kept",
+			count, JOURNAL_VALUES);
+		count = JOURNAL_VALUES;
+	}
+	JournalRecord a, b;
+	bool has_a = read_slot(0, &a);
+	bool has_b = read_slot(1, &b);
+
+	if ( !has_a && !has_b ) {
+		return false;
+	}
+	record = has_a && (!has_b || a.seq > b.seq) ? a : b;
+	memcpy(values, record.values, count * sizeof(int32_t));
+	return true;
+}
+
+void journal_set(uint8_t index, int32_t value) {
+	if ( index >= JOURNAL_VALUES ) {
+		APP_LOG(APP_LOG_LEVEL_ERROR, "journal: no value %u", index);
+		return;
+	}
+	if ( record.values[index] == value ) {
+		return;
+	}
+	record.values[index] = value;
+
+	uint64_t now = clock_ms();
+	if ( !unsaved++ ) {
+		unsaved_since = now;
+		flush_timer = app_timer_register(JOURNAL_FLUSH_MS, flush_timeout, NULL);
+	}
+	if ( unsaved >= JOURNAL_MAX_CHANGES
+		&& now - last_flush >= JOURNAL_MIN_MS ) {
+		journal_flush();
+	}
+}
+
+// writes the values over the older of the two records
+void journal_flush(void) {
+	if ( flush_timer ) {
+		app_timer_cancel(flush_timer);
+		flush_timer = NULL;
+	}
+	if ( !unsaved ) {
+		return;
+	}
+
+	uint64_t now = clock_ms();
+	if ( now - unsaved_since > stats.max_unsaved_ms ) {
+		stats.max_unsaved_ms = now - unsaved_since;
+	}
+	if ( unsaved > stats.max_unsaved ) {
+		stats.max_unsaved = unsaved;
+	}
+	stats.flushes++;
+
+	record.seq++;
+	record.check = checksum(&record);
+	persist_write_data(base_key + record.seq % 2, &record, sizeof(record));
+	unsaved = 0;
+	last_flush = now;
+}
+
+void journal_deinit(void) {
+	journal_flush();
+}
+
+const JournalStats *journal_get_stats(void) {
+	return &stats;
+}
+
+static void flush_timeout(void *data) {
+	flush_timer = NULL;
+	journal_flush();
+}
+
+static bool read_slot(uint8_t slot, JournalRecord *r) {
+	if ( persist_read_data(base_key + slot, r, sizeof(*r)) != sizeof(*r) ) {
+		return false;
+	}
+	return r->check == checksum(r);
+}
+
+// FNV-1a over everything but the checksum, which is the last field
+static uint32_t checksum(const JournalRecord *r) {
+	const uint8_t *bytes = (const uint8_t *) r;
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < sizeof(*r) - sizeof(r->check); i++) {
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	return hash;
+}
+
+static uint64_t clock_ms(void) {
+	time_t now;
+	uint16_t ms;
+	time_ms(&now, &ms);
+	return (uint64_t) now * 1000 + ms;
+}
@@ -0,0 +1,42 @@
+/* ========================================================================== */
+/* File: journal.h
+ *
+ * Write-behind storage for the daily counters; see journal.c.
+ */
+/* ========================================================================== */
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <pebble.h>
+
+#define JOURNAL_VALUES 8
+
+// flush this long after the first unsaved change
+#ifndef JOURNAL_FLUSH_MS
+#define JOURNAL_FLUSH_MS (5 * 60 * 1000)
+#endif
+
+// flush early once this many changes are unsaved ...
+#ifndef JOURNAL_MAX_CHANGES
+#define JOURNAL_MAX_CHANGES 100
+#endif
+
+// ... but never more often than this
+#ifndef JOURNAL_MIN_MS
+#define JOURNAL_MIN_MS (60 * 1000)
+#endif
+
+typedef struct {
+	uint32_t flushes;
+	uint32_t max_unsaved_ms;     // longest a change waited for a flush
+	uint16_t max_unsaved;        // most changes waiting for one flush
+} JournalStats;
+
+void journal_init(uint32_t key);
+bool journal_load(int32_t *values, uint8_t count);
+void journal_set(uint8_t index, int32_t value);
+void journal_flush(void);
+void journal_deinit(void);
+const JournalStats *journal_get_stats(void);
+
+#endif
@@ -1,7 +1,660 @@
 // ------------------------------
 //  Start of Strap API
 // ------------------------------
-var strap_api_num_samples=10;var strap_api_url="https://api.straphq.com/create/visit/with/";var strap_api_timer_send=null;var strap_api_const={};strap_api_const.KEY_OFFSET=48e3;strap_api_const.T_TIME_BASE=1e3;strap_api_const.T_TS=1;strap_api_const.T_X=2;strap_api_const.T_Y=3;strap_api_const.T_Z=4;strap_api_const.T_DID_VIBRATE=5;strap_api_const.T_ACTIVITY=2e3;strap_api_const.T_LOG=3e3;var strap_api_can_handle_msg=function(data){var sac=strap_api_const;if((sac.KEY_OFFSET+sac.T_ACTIVITY).toString()in data){return true}if((sac.KEY_OFFSET+sac.T_LOG).toString()in data){return true}return false};var strap_api_clone=function(obj){if(null==obj||"object"!=typeof obj)return obj;var copy={};for(var attr in obj){if(obj.hasOwnProperty(attr))copy[attr]=obj[attr]}return copy};var strap_api_log=function(data,min_readings,log_params){var sac=strap_api_const;var lp=log_params;if(!((sac.KEY_OFFSET+sac.T_LOG).toString()in data)){var convData=strap_api_convAcclData(data);var tmpstore=window.localStorage["strap_accl"];if(tmpstore){tmpstore=JSON.parse(tmpstore)}else{tmpstore=[]}tmpstore=tmpstore.concat(convData);if(tmpstore.length>min_readings){window.localStorage.removeItem("strap_accl");var req=new XMLHttpRequest;req.open("POST",strap_api_url,true);var tz_offset=(new Date).getTimezoneOffset()/60*-1;var query="app_id="+lp["app_id"]+"&resolution="+(lp["resolution"]||"")+"&useragent="+(lp["useragent"]||"")+"&action_url="+"STRAP_API_ACCL"+"&visitor_id="+(lp["visitor_id"]||Pebble.getAccountToken())+"&visitor_timeoffset="+tz_offset+"&accl="+encodeURIComponent(JSON.stringify(tmpstore))+"&act="+(tmpstore.length>0?tmpstore[0].act:"UNKNOWN");req.setRequestHeader("Content-type","application/x-www-form-urlencoded");req.setRequestHeader("Content-length",query.length);req.setRequestHeader("Connection","close");req.onload=function(e){if(req.readyState==4&&req.status==200){if(req.status==200){}else{}}};req.send(query)}else{window.localStorage["strap_accl"]=JSON.stringify(tmpstore)}}else{var req=new XMLHttpRequest;req.open("POST",strap_api_url,true);var tz_offset=(new Date).getTimezoneOffset()/60*-1;var query="app_id="+lp["app_id"]+"&resolution="+(lp["resolution"]||"")+"&useragent="+(lp["useragent"]||"")+"&action_url="+data[(sac.KEY_OFFSET+sac.T_LOG).toString()]+"&visitor_id="+(lp["visitor_id"]||Pebble.getAccountToken())+"&visitor_timeoffset="+tz_offset;req.setRequestHeader("Content-type","application/x-www-form-urlencoded");req.setRequestHeader("Content-length",query.length);req.setRequestHeader("Connection","close");req.onload=function(e){if(req.readyState==4&&req.status==200){if(req.status==200){}else{}}};req.send(query)}};var strap_api_convAcclData=function(data){var sac=strap_api_const;var convData=[];var time_base=parseInt(data[(sac.KEY_OFFSET+sac.T_TIME_BASE).toString()]);for(var i=0;i<strap_api_num_samples;i++){var point=sac.KEY_OFFSET+10*i;var ad={};var key=(point+sac.T_TS).toString();ad.ts=data[key]+time_base;key=(point+sac.T_X).toString();ad.x=data[key];key=(point+sac.T_Y).toString();ad.y=data[key];key=(point+sac.T_Z).toString();ad.z=data[key];key=(point+sac.T_DID_VIBRATE).toString();ad.vib=data[key]=="1"?true:false;ad.act=data[(sac.KEY_OFFSET+sac.T_ACTIVITY).toString()];convData.push(ad)}return convData};
+var strap_api_num_samples = 10;
+var strap_api_url = "https://api.straphq.com/create/visit/with/";
+// "json" posts readings as a JSON array in accl=, "col1" as the columnar
+// encoding below in accl_col=; only use col1 with an endpoint that takes it
+var strap_api_accl_format = "json";
+var strap_api_timer_send = null;
+var strap_api_const = {};
+strap_api_const.KEY_OFFSET = 48e3;
+strap_api_const.T_TIME_BASE = 1e3;
+strap_api_const.T_TS = 1;
+strap_api_const.T_X = 2;
+strap_api_const.T_Y = 3;
+strap_api_const.T_Z = 4;
+strap_api_const.T_DID_VIBRATE = 5;
+strap_api_const.T_ACTIVITY = 2e3;
+strap_api_const.T_LOG = 3e3;
+strap_api_const.T_LOG_COUNT = 3001;
+strap_api_const.T_LOG_TIME = 3002;
+strap_api_const.T_LOG_EVENT = 3003;
+strap_api_const.T_FRAME = 4e3;
+strap_api_const.FRAME_VERSION = 1;
+strap_api_const.FRAME_ENC_RAW = 0;
+strap_api_const.FRAME_ENC_DELTA = 1;
+strap_api_const.FRAME_ENC_FEATURES = 2;
+strap_api_const.FRAME_FEATURE_SIZE = 37;
+strap_api_const.FRAME_BIN_UNIT = 4;
+strap_api_const.FRAME_HEADER_SIZE = 10;
+strap_api_const.ACCL_CHUNK = 50;
+strap_api_const.UPLOAD_COL_VERSION = 1;
+strap_api_const.UPLOAD_MAX_INFLIGHT = 2;
+strap_api_const.UPLOAD_TIMEOUT_MS = 30 * 1000;
+strap_api_const.UPLOAD_RETRY_MS = 2 * 1000;
+strap_api_const.UPLOAD_RETRY_MAX_MS = 5 * 60 * 1000;
+strap_api_const.UPLOAD_MERGE_READINGS = 1000;
+strap_api_const.UPLOAD_MERGE_WINDOWS = 60;
+strap_api_const.CONFIG_RETRIES = 3;
+strap_api_const.CONFIG_RETRY_MS = 5 * 1000;
+
+// settings the watch takes in its inbox (src/strap/config.h), by the name
+// the configuration page returns them under. the inbox is sized for all of
+// them at once as int32 (src/strap/message.h), so keep the two in step
+var strap_api_config_keys = {
+    rate: 5000,             // Hz: 10, 25, 50 or 100
+    batch: 5001,            // samples per batch, 1 to 25
+    mode: 5002,             // 0 samples, 1 feature windows
+    active_mg: 5010,
+    window_s: 5011,
+    still_s: 5012,
+    probe_s: 5013,
+    idle_min_s: 5014,
+    idle_max_s: 5015,
+    budget_permille: 5016,
+    budget_cap_s: 5017
+};
+
+// -- events.def, written by tools/gen_events.js; do not edit
+// [path, carries a number], by code
+var strap_api_events = [
+    ["STRAP_START", false], // START
+    ["STRAP_FINISH", false], // FINISH
+    ["STRAP_API_BATTERY", true], // BATTERY
+    ["/open", false], // OPEN
+    ["/points-achieved", false], // POINTS_ACHIEVED
+    ["/goals-reached", false], // GOALS_REACHED
+    ["/minutes-worn", false]  // MINUTES_WORN
+];
+// -- end of events.def
+
+// the path of a T_LOG_EVENT code, and its number if it carries one
+var strap_api_event_path = function(value) {
+    var e = strap_api_events[value & 0xff];
+    if (!e) {
+        return "STRAP_API_EVENT/" + value;
+    }
+    return e[1] ? e[0] + "/" + (value >> 8) : e[0];
+};
+
+// accel readings waiting for upload, kept in localStorage as chunks of
+// ACCL_CHUNK readings under strap_accl_<n>, with strap_accl_index holding
+// the range of chunks. only the last chunk is ever rewritten, so storing a
+// message costs the size of the message, not the size of the buffer
+var strap_api_accl = {
+    index: null,    // { first: n, last: n, count: readings, act, hz: of the first }
+    tail: null      // readings of chunk index.last, parsed
+};
+
+var strap_api_accl_load = function() {
+    var sa = strap_api_accl;
+    if (sa.index) {
+        return;
+    }
+    var stored = window.localStorage["strap_accl_index"];
+    sa.index = stored ? JSON.parse(stored) : { first: 0, last: 0, count: 0 };
+    stored = window.localStorage["strap_accl_" + sa.index.last];
+    sa.tail = stored ? JSON.parse(stored) : [];
+
+    // readings left by the single-key buffer of older versions
+    var old = window.localStorage["strap_accl"];
+    if (old) {
+        window.localStorage.removeItem("strap_accl");
+        strap_api_accl_append(JSON.parse(old), 0);
+    }
+};
+
+var strap_api_accl_append = function(readings, hz) {
+    var sa = strap_api_accl;
+    var ls = window.localStorage;
+    if (sa.index.count == 0 && readings.length > 0) {
+        sa.index.act = readings[0].act;
+        sa.index.hz = hz;
+    }
+    for (var i = 0; i < readings.length; i++) {
+        if (sa.tail.length == strap_api_const.ACCL_CHUNK) {
+            ls["strap_accl_" + sa.index.last] = JSON.stringify(sa.tail);
+            sa.index.last++;
+            sa.tail = [];
+        }
+        sa.tail.push(readings[i]);
+    }
+    sa.index.count += readings.length;
+    ls["strap_accl_" + sa.index.last] = JSON.stringify(sa.tail);
+    ls["strap_accl_index"] = JSON.stringify(sa.index);
+};
+
+// the stored readings as one JSON array, joined from the chunks as they
+// are stored rather than parsed and stringified again
+var strap_api_accl_json = function() {
+    var sa = strap_api_accl;
+    var parts = [];
+    for (var n = sa.index.first; n <= sa.index.last; n++) {
+        var chunk = window.localStorage["strap_accl_" + n];
+        if (chunk && chunk.length > 2) {
+            parts.push(chunk.slice(1, -1));
+        }
+    }
+    return "[" + parts.join(",") + "]";
+};
+
+var strap_api_accl_clear = function() {
+    var sa = strap_api_accl;
+    for (var n = sa.index.first; n <= sa.index.last; n++) {
+        window.localStorage.removeItem("strap_accl_" + n);
+    }
+    sa.index = { first: 0, last: 0, count: 0 };
+    sa.tail = [];
+    window.localStorage["strap_accl_index"] = JSON.stringify(sa.index);
+};
+
+var strap_api_can_handle_msg = function(data) {
+    var sac = strap_api_const;
+    if ((sac.KEY_OFFSET + sac.T_ACTIVITY).toString() in data) {
+        return true;
+    }
+    if ((sac.KEY_OFFSET + sac.T_LOG).toString() in data) {
+        return true;
+    }
+    if ((sac.KEY_OFFSET + sac.T_LOG_EVENT).toString() in data) {
+        return true;
+    }
+    if ((sac.KEY_OFFSET + sac.T_FRAME).toString() in data) {
+        return true;
+    }
+    return false;
+};
+
+var strap_api_clone = function(obj) {
+    if (null == obj || "object" != typeof obj) return obj;
+    var copy = {};
+    for (var attr in obj) {
+        if (obj.hasOwnProperty(attr)) copy[attr] = obj[attr];
+    }
+    return copy;
+};
+
+var strap_api_log = function(data, min_readings, log_params) {
+    var sac = strap_api_const;
+    var lp = log_params;
+    var log = (sac.KEY_OFFSET + sac.T_LOG).toString();
+    var code = (sac.KEY_OFFSET + sac.T_LOG_EVENT).toString();
+    var frame = data[(sac.KEY_OFFSET + sac.T_FRAME).toString()];
+    // the sampling rate from the frame header, 0 from older watches
+    var hz = frame && frame.length > 3 ? frame[3] : 0;
+    if (frame && frame[1] == sac.FRAME_ENC_FEATURES) {
+        var windows = strap_api_decodeFeatures(frame);
+        if (windows.length > 0) {
+            strap_api_upload({
+                q: strap_api_query(lp, "STRAP_API_FEATURES"),
+                feat: JSON.stringify(windows),
+                windows: windows.length,
+                act: data[(sac.KEY_OFFSET + sac.T_ACTIVITY).toString()],
+                hz: hz
+            });
+        }
+    } else if (!(log in data) && !(code in data)) {
+        var convData = strap_api_convAcclData(data);
+        strap_api_accl_load();
+        // a post has one rate, so readings at the old one go first
+        if (convData.length > 0 && strap_api_accl.index.count > 0 &&
+                strap_api_accl.index.hz != hz) {
+            strap_api_accl_upload(lp);
+        }
+        if (convData.length > 0) {
+            strap_api_accl_append(convData, hz);
+        }
+        if (strap_api_accl.index.count > min_readings) {
+            strap_api_accl_upload(lp);
+        }
+    } else {
+        // the watch folds back to back repeats of an event into one message,
+        // and events spooled while the phone was away keep their time
+        var count = data[(sac.KEY_OFFSET + sac.T_LOG_COUNT).toString()];
+        var ts = data[(sac.KEY_OFFSET + sac.T_LOG_TIME).toString()];
+        strap_api_upload({
+            q: strap_api_query(lp, log in data ?
+                data[log] : strap_api_event_path(data[code])),
+            count: count > 1 ? count : 1,
+            ts: ts ? ts * 1000 : 0
+        });
+    }
+};
+
+// the readings are safe in the upload queue before the chunks go
+var strap_api_accl_upload = function(lp) {
+    var sa = strap_api_accl;
+    strap_api_upload({
+        q: strap_api_query(lp, "STRAP_API_ACCL"),
+        accl: strap_api_accl_json(),
+        readings: sa.index.count,
+        act: sa.index.act,
+        hz: sa.index.hz || 0
+    });
+    strap_api_accl_clear();
+};
+
+var strap_api_query = function(lp, action_url) {
+    var tz_offset = new Date().getTimezoneOffset() / 60 * -1;
+    return "app_id=" + lp["app_id"] +
+        "&resolution=" + (lp["resolution"] || "") +
+        "&useragent=" + (lp["useragent"] || "") +
+        "&action_url=" + action_url +
+        "&visitor_id=" + (lp["visitor_id"] || Pebble.getAccountToken()) +
+        "&visitor_timeoffset=" + tz_offset;
+};
+
+// posts waiting for a 2xx from strap_api_url, oldest first. each is kept
+// in localStorage as strap_upq_<n> until it succeeds, with strap_upq_index
+// holding the range, so nothing is lost to a failed request or a restart.
+// UPLOAD_MAX_INFLIGHT go at once; a failure holds the queue back for
+// UPLOAD_RETRY_MS, doubling with each failure in a row up to
+// UPLOAD_RETRY_MAX_MS. a post that has not gone yet takes in the next one
+// like it: event counts add up, accel readings join up to UPLOAD_MERGE_READINGS
+// and feature windows up to UPLOAD_MERGE_WINDOWS
+var strap_api_upq = {
+    index: null,    // { first: n, last: n }, items first to last - 1
+    inflight: {},
+    active: 0,
+    backoff: 0,
+    timer: null
+};
+
+var strap_api_upload_load = function() {
+    var uq = strap_api_upq;
+    if (!uq.index) {
+        var stored = window.localStorage["strap_upq_index"];
+        uq.index = stored ? JSON.parse(stored) : { first: 0, last: 0 };
+    }
+};
+
+// sends whatever an earlier run left in the queue
+var strap_api_upload_resume = function() {
+    strap_api_upload_load();
+    strap_api_upload_pump();
+};
+
+var strap_api_upload = function(item) {
+    var uq = strap_api_upq;
+    var ls = window.localStorage;
+    strap_api_upload_load();
+
+    var n = uq.index.last - 1;
+    var tail = n >= uq.index.first && !uq.inflight[n] ?
+        JSON.parse(ls["strap_upq_" + n] || "null") : null;
+    if (tail && tail.q == item.q && !tail.accl && !item.accl &&
+            !tail.feat && !item.feat && !tail.ts && !item.ts) {
+        tail.count += item.count;
+        ls["strap_upq_" + n] = JSON.stringify(tail);
+    } else if (tail && tail.q == item.q && tail.feat && item.feat &&
+            tail.hz == item.hz &&
+            tail.windows + item.windows <= strap_api_const.UPLOAD_MERGE_WINDOWS) {
+        tail.feat = tail.feat.slice(0, -1) + "," + item.feat.slice(1);
+        tail.windows += item.windows;
+        ls["strap_upq_" + n] = JSON.stringify(tail);
+    } else if (tail && tail.q == item.q && tail.accl && item.accl &&
+            tail.hz == item.hz &&
+            tail.readings + item.readings <= strap_api_const.UPLOAD_MERGE_READINGS) {
+        tail.accl = tail.accl.slice(0, -1) + "," + item.accl.slice(1);
+        tail.readings += item.readings;
+        ls["strap_upq_" + n] = JSON.stringify(tail);
+    } else {
+        ls["strap_upq_" + uq.index.last] = JSON.stringify(item);
+        uq.index.last++;
+        ls["strap_upq_index"] = JSON.stringify(uq.index);
+    }
+    strap_api_upload_pump();
+};
+
+var strap_api_upload_pump = function() {
+    var uq = strap_api_upq;
+    if (uq.timer) {
+        return;     // backing off
+    }
+    for (var n = uq.index.first; n < uq.index.last &&
+            uq.active < strap_api_const.UPLOAD_MAX_INFLIGHT; n++) {
+        var item = !uq.inflight[n] && window.localStorage["strap_upq_" + n];
+        if (item) {
+            strap_api_upload_send(n, JSON.parse(item));
+        }
+    }
+};
+
+var strap_api_upload_send = function(n, item) {
+    var sac = strap_api_const;
+    var uq = strap_api_upq;
+    var query = item.q;
+    if (item.accl) {
+        query += (strap_api_accl_format == "col1" ?
+            "&accl_col=" + strap_api_encodeUpload(JSON.parse(item.accl)) :
+            "&accl=" + encodeURIComponent(item.accl)) +
+            "&act=" + item.act + (item.hz ? "&hz=" + item.hz : "");
+    } else if (item.feat) {
+        query += "&feat=" + encodeURIComponent(item.feat) + "&act=" + item.act +
+            (item.hz ? "&hz=" + item.hz : "");
+    } else {
+        if (item.count > 1) {
+            query += "&count=" + item.count;
+        }
+        if (item.ts) {
+            query += "&ts=" + item.ts;
+        }
+    }
+
+    uq.inflight[n] = true;
+    uq.active++;
+    var done = false;
+    var finish = function(ok) {
+        if (done) {
+            return;
+        }
+        done = true;
+        clearTimeout(timeout);
+        delete uq.inflight[n];
+        uq.active--;
+        strap_api_upload_done(n, ok);
+    };
+
+    var req = new XMLHttpRequest();
+    req.open("POST", strap_api_url, true);
+    req.setRequestHeader("Content-type", "application/x-www-form-urlencoded");
+    req.setRequestHeader("Content-length", query.length);
+    req.setRequestHeader("Connection", "close");
+    req.onload = function(e) {
+        finish(req.readyState == 4 && req.status >= 200 && req.status < 300);
+    };
+    req.onerror = function(e) {
+        finish(false);
+    };
+    var timeout = setTimeout(function() {
+        req.abort();
+        finish(false);
+    }, sac.UPLOAD_TIMEOUT_MS);
+    req.send(query);
+};
+
+var strap_api_upload_done = function(n, ok) {
+    var sac = strap_api_const;
+    var uq = strap_api_upq;
+    var ls = window.localStorage;
+    if (ok) {
+        ls.removeItem("strap_upq_" + n);
+        while (uq.index.first < uq.index.last &&
+                !ls["strap_upq_" + uq.index.first]) {
+            uq.index.first++;
+        }
+        if (uq.index.first == uq.index.last) {
+            uq.index = { first: 0, last: 0 };
+        }
+        ls["strap_upq_index"] = JSON.stringify(uq.index);
+        uq.backoff = 0;
+        strap_api_upload_pump();
+    } else if (!uq.timer) {
+        uq.backoff = uq.backoff ?
+            Math.min(uq.backoff * 2, sac.UPLOAD_RETRY_MAX_MS) : sac.UPLOAD_RETRY_MS;
+        uq.timer = setTimeout(function() {
+            uq.timer = null;
+            strap_api_upload_pump();
+        }, uq.backoff);
+    }
+};
+
+// keeps the settings named in strap_api_config_keys and sends them to the
+// watch. the watch does not keep them across a restart of the app, so
+// they go again on every "ready"
+var strap_api_configure = function(settings) {
+    var ls = window.localStorage;
+    var stored = JSON.parse(ls["strap_config"] || "{}");
+    for (var name in strap_api_config_keys) {
+        var v = parseInt(settings[name], 10);
+        if (name in settings && !isNaN(v)) {
+            stored[name] = v;
+        }
+    }
+    ls["strap_config"] = JSON.stringify(stored);
+    strap_api_config_send(0);
+};
+
+var strap_api_config_send = function(attempt) {
+    var sac = strap_api_const;
+    var stored = JSON.parse(window.localStorage["strap_config"] || "{}");
+    var msg = {}, empty = true;
+    for (var name in stored) {
+        if (name in strap_api_config_keys) {
+            msg[sac.KEY_OFFSET + strap_api_config_keys[name]] = stored[name];
+            empty = false;
+        }
+    }
+    if (empty) {
+        return;
+    }
+    Pebble.sendAppMessage(msg, function(e) {}, function(e) {
+        if (attempt < sac.CONFIG_RETRIES) {
+            setTimeout(function() {
+                strap_api_config_send(attempt + 1);
+            }, sac.CONFIG_RETRY_MS * (attempt + 1));
+        }
+    });
+};
+
+var strap_api_convAcclData = function(data) {
+    var sac = strap_api_const;
+    var frame = data[(sac.KEY_OFFSET + sac.T_FRAME).toString()];
+    var act = data[(sac.KEY_OFFSET + sac.T_ACTIVITY).toString()];
+    if (frame) {
+        return strap_api_decodeFrame(frame, act);
+    }
+
+    // watches older than the packed frame send one tuplet per value
+    var convData = [];
+    if (!((sac.KEY_OFFSET + sac.T_TIME_BASE).toString() in data)) {
+        return convData;
+    }
+    var time_base = parseInt(data[(sac.KEY_OFFSET + sac.T_TIME_BASE).toString()]);
+    for (var i = 0; i < strap_api_num_samples; i++) {
+        var point = sac.KEY_OFFSET + 10 * i;
+        var ad = {};
+        var key = (point + sac.T_TS).toString();
+        ad.ts = data[key] + time_base;
+        key = (point + sac.T_X).toString();
+        ad.x = data[key];
+        key = (point + sac.T_Y).toString();
+        ad.y = data[key];
+        key = (point + sac.T_Z).toString();
+        ad.z = data[key];
+        key = (point + sac.T_DID_VIBRATE).toString();
+        ad.vib = data[key] == "1" ? true : false;
+        ad.act = act;
+        convData.push(ad);
+    }
+    return convData;
+};
+
+// encodes readings for upload, one column at a time so that each compresses
+// on its own (tools/host/upload_decode.js is the reference decoder):
+//
+//   version                     byte, UPLOAD_COL_VERSION
+//   count, first ts             varints
+//   activities                  varint n, then n of (varint length, bytes)
+//   ts                          varint gap from the previous reading
+//   x, y, z                     zigzag varint change from the previous one
+//   vib                         varint run lengths, starting with false
+//   act                         (varint activity index, varint run length)
+//
+// and sends the bytes as unpadded URL-safe base64
+var strap_api_encodeUpload = function(readings) {
+    var b = [strap_api_const.UPLOAD_COL_VERSION];
+    var varint = function(v) {
+        while (v >= 0x80) {
+            b.push(v % 0x80 + 0x80);
+            v = Math.floor(v / 0x80);
+        }
+        b.push(v);
+    };
+    var zigzag = function(v) { return v < 0 ? -2 * v - 1 : 2 * v; };
+    var n = readings.length;
+
+    varint(n);
+    varint(n > 0 ? readings[0].ts : 0);
+
+    var acts = [], actIndex = {};
+    readings.forEach(function(r) {
+        var a = r.act || "";
+        if (!(a in actIndex)) {
+            actIndex[a] = acts.length;
+            acts.push(a);
+        }
+    });
+    varint(acts.length);
+    acts.forEach(function(a) {
+        varint(a.length);
+        for (var i = 0; i < a.length; i++) b.push(a.charCodeAt(i) & 0xff);
+    });
+
+    var i;
+    for (i = 1; i < n; i++) varint(zigzag(readings[i].ts - readings[i - 1].ts));
+    ["x", "y", "z"].forEach(function(axis) {
+        var prev = 0;
+        for (var i = 0; i < n; i++) {
+            varint(zigzag(readings[i][axis] - prev));
+            prev = readings[i][axis];
+        }
+    });
+
+    var vib = false, run = 0;
+    for (i = 0; i < n; i++) {
+        if (!!readings[i].vib != vib) {
+            varint(run);
+            vib = !vib;
+            run = 0;
+        }
+        run++;
+    }
+    varint(run);
+
+    for (i = 0; i < n; i += run) {
+        var act = actIndex[readings[i].act || ""];
+        for (run = 1; i + run < n && actIndex[readings[i + run].act || ""] == act; run++);
+        varint(act);
+        varint(run);
+    }
+
+    return strap_api_base64(b);
+};
+
+var strap_api_base64 = function(b) {
+    var abc = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+    var out = "";
+    for (var i = 0; i < b.length; i += 3) {
+        var v = b[i] << 16 | (b[i + 1] || 0) << 8 | (b[i + 2] || 0);
+        out += abc[v >> 18 & 63] + abc[v >> 12 & 63];
+        if (i + 1 < b.length) out += abc[v >> 6 & 63];
+        if (i + 2 < b.length) out += abc[v & 63];
+    }
+    return out;
+};
+
+// decodes the byte array laid out in src/strap/frame.h
+var strap_api_decodeFrame = function(b, act) {
+    var sac = strap_api_const;
+    var convData = [];
+    if (b.length < sac.FRAME_HEADER_SIZE || b[0] != sac.FRAME_VERSION) {
+        return convData;
+    }
+    var u16 = function(o) { return b[o] | (b[o + 1] << 8); };
+    var s16 = function(o) { var v = u16(o); return v >= 0x8000 ? v - 0x10000 : v; };
+
+    var count = b[2];
+    var ts = (b[4] | (b[5] << 8) | (b[6] << 16)) + b[7] * 0x1000000 +
+        u16(8) * 0x100000000;
+
+    if (b[1] == sac.FRAME_ENC_DELTA) {
+        var pos = sac.FRAME_HEADER_SIZE;
+        var varint = function() {
+            var v = 0, shift = 0, c;
+            do {
+                c = b[pos++];
+                v += (c & 0x7f) * Math.pow(2, shift);
+                shift += 7;
+            } while (c & 0x80);
+            return v;
+        };
+        var unzigzag = function(v) { return v % 2 ? -(v + 1) / 2 : v / 2; };
+        var x = 0, y = 0, z = 0, dt = 0;
+        while (convData.length < count && pos < b.length) {
+            var tag = varint();
+            var repeat = 1, vib = false;
+            if (tag & 1) {
+                vib = (tag & 2) != 0;
+                if (tag & 4) dt = varint();
+                x += unzigzag(varint());
+                y += unzigzag(varint());
+                z += unzigzag(varint());
+            } else {
+                repeat = tag / 2;
+            }
+            for (var r = 0; r < repeat; r++) {
+                if (convData.length > 0) ts += dt;
+                convData.push({ ts: ts, x: x, y: y, z: z, vib: vib, act: act });
+            }
+        }
+        return convData;
+    }
+
+    var mask = sac.FRAME_HEADER_SIZE + 8 * count;
+    for (var i = 0; i < count; i++) {
+        var o = sac.FRAME_HEADER_SIZE + 8 * i;
+        ts += u16(o + 6);
+        convData.push({
+            ts: ts,
+            x: s16(o),
+            y: s16(o + 2),
+            z: s16(o + 4),
+            vib: (b[mask + (i >> 3)] >> (i & 7) & 1) == 1,
+            act: act
+        });
+    }
+    return convData;
+};
+
+// the feature windows of a FRAME_ENC_FEATURES frame, as posted in feat=:
+// { ts, n, zc, mean, std, p2p: [x, y, z], mag: [mean, std, p2p], dom, bins }
+var strap_api_decodeFeatures = function(b) {
+    var sac = strap_api_const;
+    var windows = [];
+    if (b.length < sac.FRAME_HEADER_SIZE || b[0] != sac.FRAME_VERSION) {
+        return windows;
+    }
+    var u16 = function(o) { return b[o] | (b[o + 1] << 8); };
+    var s16 = function(o) { var v = u16(o); return v >= 0x8000 ? v - 0x10000 : v; };
+    var ts = (b[4] | (b[5] << 8) | (b[6] << 16)) + b[7] * 0x1000000 +
+        u16(8) * 0x100000000;
+
+    for (var i = 0; i < b[2]; i++) {
+        var o = sac.FRAME_HEADER_SIZE + i * sac.FRAME_FEATURE_SIZE;
+        if (o + sac.FRAME_FEATURE_SIZE > b.length) {
+            break;
+        }
+        ts += u16(o);
+        var bins = [];
+        for (var k = 29; k < sac.FRAME_FEATURE_SIZE; k++) {
+            bins.push(b[o + k] * sac.FRAME_BIN_UNIT);
+        }
+        windows.push({
+            ts: ts,
+            n: b[o + 2],
+            zc: b[o + 3],
+            mean: [s16(o + 4), s16(o + 6), s16(o + 8)],
+            std: [u16(o + 10), u16(o + 12), u16(o + 14)],
+            p2p: [u16(o + 16), u16(o + 18), u16(o + 20)],
+            mag: [u16(o + 22), u16(o + 24), u16(o + 26)],
+            dom: b[o + 28],
+            bins: bins
+        });
+    }
+    return windows;
+};
 
 Pebble.addEventListener("appmessage",
     function(e) {
@@ -38,6 +691,11 @@ Pebble.addEventListener("appmessage",
 Pebble.addEventListener("ready",
   function(e) {
     console.log("JavaScript app ready and running!");
+
+    // Strap API: posts that did not go through last time, and the
+    // settings the watch was given. DO NOT EDIT
+    strap_api_upload_resume();
+    strap_api_config_send(0);
   }
 );
 
@@ -49,10 +707,13 @@ Pebble.addEventListener("showConfiguration",
 
 Pebble.addEventListener("webviewclosed",
   function(e) {
+    if (!e.response || e.response == "CANCELLED") {
+      return;
+    }
     var configuration = JSON.parse(decodeURIComponent(e.response));
     console.log("Configuration window returned: ", JSON.stringify(configuration));
 
-    
-
+    // Strap API: sampling and duty settings from the page. DO NOT EDIT
+    strap_api_configure(configuration);
   }
 );
\ No newline at end of file
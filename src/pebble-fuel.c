@@ -12,6 +12,10 @@
 
 // ---------------- Local includes	e.g., "file.h"
 #include "strap/strap.h"
+#include "steps.h"
+#include "journal.h"
+#include "history.h"
+#include "history_view.h"
 
 // ---------------- Constant definitions
 
@@ -25,24 +29,47 @@
 // Max definitions
 #define MAX_INFO_LENGTH 100
 #define MAX_DATE_CHAR 30
+#define DATE_FORMAT "%B %d, %Y\n%A"
 #define MAX_TIME_CHAR 10
+#define STATS_COUNT 5
 
 // keys for persistant storage
 #define POINTS_COUNT_KEY 1
 #define STREAK_KEY 2
 #define GOAL_REACHED_KEY 3
-#define DATE_KEY 4
+#define DATE_KEY 4 // no longer written; the journal holds the day number
 #define RECORD_KEY 5
 #define BEST_STREAK_KEY 6
+#define JOURNAL_KEY 10 // and 11
+#define HISTORY_KEY 20 // to 20 + HISTORY_KEYS
 
 #define BEAT 200 // used for standard length of custom vibe
 
+#define SECONDS_IN_DAY 86400
+#define ACTIVE_MINUTE_STEPS 40 // steps in a minute for it to count as active
+#define TAP_QUIET_S 5 // taps this soon after a step are the stride, not a flick
+
 // fonts
 
 // ---------------- Macro definitions
 
 // ---------------- Structures/Types
 
+// counters kept in the journal
+enum {
+	JOURNAL_POINTS,
+	JOURNAL_STREAK,
+	JOURNAL_GOAL_REACHED,
+	JOURNAL_RECORD,
+	JOURNAL_BEST_STREAK,
+	JOURNAL_DAY,
+	JOURNAL_MINUTES_WORN,
+	JOURNAL_ACTIVE_MINUTES,
+	JOURNAL_COUNT
+};
+_Static_assert(JOURNAL_COUNT <= JOURNAL_VALUES,
+	"every counter needs a slot in the journal record");
+
 // used for custom vibe
 static const uint32_t const beat[] = { 
 	1 * BEAT, // vibe
@@ -70,6 +97,12 @@ static int goal_reached_today;
 static int record;
 static int goal = 1000;
 static int best_streak;
+static int counters_day;         // the day the counters are for
+static int minutes_worn;
+static int active_minutes;
+static int minute_steps;         // steps so far this minute
+static time_t last_step_time;
+static AppTimer *midnight_timer;
 static char *date_string;
 
 /* used for graphics */
@@ -79,20 +112,31 @@ static char *info_string;
 static char *time_string;
 static TextLayer *time_text;
 static TextLayer *date_text;
-static TextLayer *points_text;
-static TextLayer *status_bar;
-static TextLayer *status_helper_bar;
+static Layer *status_bar;
+static Layer *info_layer;
+static GFont info_font;
+static int bar_height = -1;              // pixels of the status bar filled
+static int shown_stats[STATS_COUNT];     // values info_string was made from
 static int anim_step;
 
 // ---------------- Private prototypes
-static void tap_handler(AccelAxisType axis, int32_t direction);
+static void step_handler(uint32_t steps);
 static void window_load(Window *window);
 static void update_points_display();
+static void status_bar_update(Layer *layer, GContext *ctx);
+static void info_layer_update(Layer *layer, GContext *ctx);
 static void window_unload(Window *window);
 static void init(void);
 static void deinit(void);
 static void reset_day();
-static void refresh_day();
+static void load_counters();
+static void save_counters();
+static int today();
+static int local_day(struct tm *tm);
+static void tap_handler(AccelAxisType axis, int32_t direction);
+static void refresh_day(struct tm *tm);
+static void schedule_midnight();
+static void midnight_timeout(void *data);
 static void minute_tick_handler(struct tm *tick_time, TimeUnits units_changed);
 static void celebrate_goal();
 static void goal_anim_setup(struct Animation *animation);
@@ -136,16 +180,8 @@ static void init(void) {
 	time_string = calloc(MAX_TIME_CHAR, sizeof(char));
 
 	// get persistent data
-	points_count = persist_exists(POINTS_COUNT_KEY) ? 
-		persist_read_int(POINTS_COUNT_KEY) : 0;
-	streak = persist_exists(STREAK_KEY) ? 
-		persist_read_int(STREAK_KEY) : 0;
-	goal_reached_today = persist_exists(GOAL_REACHED_KEY) ? 
-		persist_read_int(GOAL_REACHED_KEY) : 0;
-	record = persist_exists(RECORD_KEY) ? 
-		persist_read_int(RECORD_KEY) : 0;
-	best_streak = persist_exists(BEST_STREAK_KEY) ? 
-		persist_read_int(BEST_STREAK_KEY) : streak;
+	history_init(HISTORY_KEY);
+	load_counters();
 
 	// begin creating layers
 	// get bounds for use in creating layers
@@ -174,61 +210,67 @@ static void init(void) {
 	text_layer_set_font(date_text, 
 		fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD));
 
-	// initialize status helper bar (background)
-	status_helper_bar = text_layer_create((GRect) { 
+	// initialize status bar, drawn bottom up as points come in
+	status_bar = layer_create((GRect) { 
 		.origin = { 0, 0 }, 
-		.size = { STATUS_BAR_WIDTH, WINDOW_HEIGHT} 
+		.size = { STATUS_BAR_WIDTH, WINDOW_HEIGHT } 
 	});
-	text_layer_set_background_color(status_helper_bar, GColorWhite);
-
-	// initialize status bar
-	status_bar = text_layer_create((GRect) { 
-		.origin = { 0, 0 }, 
-		.size = { STATUS_BAR_WIDTH, WINDOW_HEIGHT - (WINDOW_HEIGHT 
-			* points_count / goal) } 
-	});
-	text_layer_set_background_color(status_bar, GColorBlack);
+	layer_set_update_proc(status_bar, status_bar_update);
 
 	// initialize points layer
-	points_text = text_layer_create((GRect) { 
+	info_layer = layer_create((GRect) { 
 		.origin = { STATUS_BAR_WIDTH + BUFFER, WINDOW_HEIGHT - 60 }, 
 		.size = { bounds.size.w - STATUS_BAR_WIDTH - BUFFER, 60 } 
 	});
-	text_layer_set_text_color(points_text, GColorWhite);
-	text_layer_set_background_color(points_text, GColorBlack);
-	text_layer_set_font(points_text, fonts_get_system_font(FONT_KEY_GOTHIC_14));
-	text_layer_set_text_alignment(points_text, GTextAlignmentCenter);
+	layer_set_update_proc(info_layer, info_layer_update);
+	info_font = fonts_get_system_font(FONT_KEY_GOTHIC_14);
+	for (int i = 0; i < STATS_COUNT; i++) {
+		shown_stats[i] = -1;
+	}
 
 	// add layers to window layer (order matters)
-	layer_add_child(window_layer, text_layer_get_layer(status_helper_bar));
-	layer_add_child(window_layer, text_layer_get_layer(status_bar));
+	layer_add_child(window_layer, status_bar);
 	layer_add_child(window_layer, text_layer_get_layer(time_text));
 	layer_add_child(window_layer, text_layer_get_layer(date_text));
-	layer_add_child(window_layer, text_layer_get_layer(points_text));
+	layer_add_child(window_layer, info_layer);
+
+	// roll the counters over if the app was closed over midnight, and
+	// again at every midnight from here on
+	time_t now = time(NULL);
+	refresh_day(localtime(&now));
+	schedule_midnight();
 
 	window_stack_push(window, true);
 
-	int in_size = app_message_inbox_size_maximum();
-	int out_size = app_message_outbox_size_maximum();
-	app_message_open(in_size, out_size);
+	// the app sends and receives nothing of its own, so the buffers only
+	// need to hold strap's messages; the firmware takes them from the heap
+	app_message_open(STRAP_INBOX_SIZE, STRAP_OUTBOX_SIZE);
 
-	// initialize strap
+	// initialize strap; it owns the accelerometer and shares it with the
+	// step counter
+	steps_init(step_handler);
 	strap_init();
-	strap_log_event("/open");
+	strap_set_accel_handler(steps_process);
+	strap_set_tap_handler(tap_handler);
+	strap_log_code(STRAP_EV_OPEN, 0);
 
 }
 
 static void deinit(void) {
 	
 	strap_deinit();
+	history_view_destroy();
+	app_timer_cancel(midnight_timer);
 
 	// write persist variables
-	persist_write_int(POINTS_COUNT_KEY, points_count);
-	persist_write_int(STREAK_KEY, streak);
-	persist_write_int(GOAL_REACHED_KEY, goal_reached_today);
-	persist_write_string(DATE_KEY, date_string);
-	persist_write_int(RECORD_KEY, record);
-	persist_write_int(BEST_STREAK_KEY, best_streak);
+	save_counters();
+	journal_deinit();
+#ifdef DEBUG
+	const JournalStats *journal = journal_get_stats();
+	APP_LOG(APP_LOG_LEVEL_INFO, "journal: %lu flushes, %lu ms and %u changes "
+		"unsaved at most", (unsigned long) journal->flushes, 
+		(unsigned long) journal->max_unsaved_ms, journal->max_unsaved);
+#endif
 
 	// free strings
 	free(info_string);
@@ -239,9 +281,8 @@ static void deinit(void) {
 	window_destroy(window);
 	text_layer_destroy(date_text);
 	text_layer_destroy(time_text);
-	text_layer_destroy(status_helper_bar);
-	text_layer_destroy(status_bar);
-	text_layer_destroy(points_text);
+	layer_destroy(status_bar);
+	layer_destroy(info_layer);
 }
 
 // when app window is opened
@@ -253,45 +294,29 @@ static void window_load(Window *window) {
 
 	// subscribes to services
 	tick_timer_service_subscribe(MINUTE_UNIT, minute_tick_handler);	
-	accel_tap_service_subscribe(tap_handler);
 }
 
 static void window_unload(Window *window) {
 	tick_timer_service_unsubscribe();
-	accel_tap_service_unsubscribe();
 }
 
-// called when the user shakes the pebble
-static void tap_handler(AccelAxisType axis, int32_t direction) {
-	points_count++;
+// called with the steps found in each accelerometer batch
+static void step_handler(uint32_t steps) {
+	points_count += steps;
+	minute_steps += steps;
+	last_step_time = time(NULL);
 	update_points_display();
-	strap_log_event("/points-achieved");
+	strap_log_code(STRAP_EV_POINTS_ACHIEVED, 0);
 }
 
-// called when the user shakes his/her pebble
+// called when the user takes steps
 static void update_points_display() {
 
 	// check if current point count is a record
 	if (points_count >= record ) {
 		record = points_count;
-		persist_write_int(RECORD_KEY, record);	
 	}
 
-	// get info string to print
-	snprintf(info_string, MAX_INFO_LENGTH, 
-		"points: %d/%d\nstreak: %d/%d\nrecord: %d\nbattery: %d%%", 
-		points_count, goal, streak, best_streak, record, 
-		battery_state_service_peek().charge_percent);
-
-	// push string to text layer
-	text_layer_set_text(points_text, info_string);
-
-	// adjust size of status bar based on new points
-	text_layer_set_size(status_bar, (GSize) { 
-		.w = STATUS_BAR_WIDTH, 
-		.h = WINDOW_HEIGHT - (WINDOW_HEIGHT * points_count / goal) 
-	});	
-
 	// check for goal condition
 	if (points_count >= goal && !goal_reached_today) {
 		celebrate_goal();
@@ -301,15 +326,54 @@ static void update_points_display() {
 
 		if ( streak > best_streak ) {
 			best_streak = streak;
-			persist_write_int(BEST_STREAK_KEY, best_streak);
 		}
+
+		// the goal is saved right away rather than with the next flush
+		save_counters();
+		journal_flush();
 	}
+	save_counters();
+
+	// get info string to print, only when one of its values changed
+	int stats[STATS_COUNT] = { points_count, streak, best_streak, record, 
+		battery_state_service_peek().charge_percent };
+	if ( memcmp(stats, shown_stats, sizeof(stats)) ) {
+		snprintf(info_string, MAX_INFO_LENGTH, 
+			"points: %d/%d\nstreak: %d/%d\nrecord: %d\nbattery: %d%%", 
+			points_count, goal, streak, best_streak, record, stats[4]);
+		memcpy(shown_stats, stats, sizeof(stats));
+		layer_mark_dirty(info_layer);
+	}
+
+	// redraw the status bar only when it grows by a whole pixel
+	int height = points_count >= goal ? 
+		WINDOW_HEIGHT : WINDOW_HEIGHT * points_count / goal;
+	if ( height != bar_height ) {
+		bar_height = height;
+		layer_mark_dirty(status_bar);
+	}
+}
+
+// fills the status bar bottom up in proportion to the points
+static void status_bar_update(Layer *layer, GContext *ctx) {
+	GRect filled = layer_get_bounds(layer);
+	filled.origin.y = filled.size.h - bar_height;
+	filled.size.h = bar_height;
+
+	graphics_context_set_fill_color(ctx, GColorWhite);
+	graphics_fill_rect(ctx, filled, 0, GCornerNone);
+}
+
+static void info_layer_update(Layer *layer, GContext *ctx) {
+	graphics_context_set_text_color(ctx, GColorWhite);
+	graphics_draw_text(ctx, info_string, info_font, layer_get_bounds(layer), 
+		GTextOverflowModeWordWrap, GTextAlignmentCenter, NULL);
 }
 
 // goal animation and custom vibration
 static void celebrate_goal() {
 
-	anim_step = 0;
+	anim_step = -1;
 
 	// goal animation
 	Animation *goal_anim = animation_create();
@@ -323,7 +387,7 @@ static void celebrate_goal() {
 
 	// give custom vibration
 	vibes_enqueue_custom_pattern(custom_vibration);	
-	strap_log_event("/goals-reached");
+	strap_log_code(STRAP_EV_GOALS_REACHED, 0);
 }
 
 static void goal_anim_setup(struct Animation *animation) {
@@ -331,16 +395,23 @@ static void goal_anim_setup(struct Animation *animation) {
 		fonts_get_system_font(FONT_KEY_BITHAM_42_BOLD));
 }
 
+// flashes "GOAL" once every BEAT. the step is worked out from how far the
+// animation has run, so frames are never slept through and the text only
+// changes when the step does
 static void goal_anim_update(struct Animation *animation, const uint32_t time_normalized) {
-	if ( anim_step ) {
+	int step = (uint64_t) time_normalized * ANIMATION_DURATION_MS 
+		/ ANIMATION_NORMALIZED_MAX / BEAT;
+
+	if ( step == anim_step ) {
+		return;
+	}
+	anim_step = step;
+
+	if ( step % 2 ) {
 		text_layer_set_text(time_text, "GOAL");		
-		anim_step = 0;
 	} else {
 		text_layer_set_text(time_text, "");	
-		anim_step = 1;
 	}
-
-	psleep(BEAT);
 }
 
 static void goal_anim_teardown(struct Animation *animation) {
@@ -371,42 +442,83 @@ static void update_time() {
 // called every minute
 static void minute_tick_handler(struct tm *tick_time, TimeUnits units_changed) {
 	update_time();
-	refresh_day();
-	strap_log_event("/minutes-worn");
+	refresh_day(tick_time);
+	strap_log_code(STRAP_EV_MINUTES_WORN, 0);
+
+	minutes_worn++;
+	if ( minute_steps >= ACTIVE_MINUTE_STEPS ) {
+		active_minutes++;
+	}
+	minute_steps = 0;
+	save_counters();
 }
 
-// refreshes the day string
-static void refresh_day() {
+// a flick of the wrist shows the history, and another hides it
+static void tap_handler(AccelAxisType axis, int32_t direction) {
+	if ( time(NULL) - last_step_time < TAP_QUIET_S ) {
+		return;
+	}
 
-	// store date in date_string
-	time_t currentTime = time(NULL);
-	struct tm* tm = localtime(&currentTime);
-	strftime(date_string, MAX_DATE_CHAR, "%B %d, %Y\n%A", tm);
+	HistoryDay live = {
+		.points = points_count,
+		.goal_met = goal_reached_today,
+		.minutes_worn = minutes_worn,
+		.active_minutes = active_minutes,
+	};
+	history_view_toggle(today(), &live, goal);
+}
 
-	// check for a change in the date
-	char *previous_date = calloc(MAX_DATE_CHAR, sizeof(char));
-	if (persist_exists(DATE_KEY)) { // if there exists previous date
+// rolls the counters over when the local day is no longer theirs. this
+// runs every minute, so it is an integer compare unless the day changed.
+// the midnight timer normally gets here first; the minute tick catches a
+// clock that jumped past midnight, after a time zone change say
+static void refresh_day(struct tm *tm) {
+	int day = local_day(tm);
 
-		// get the date that existed last time this app was open, 
-		// store in previous_date
-		persist_read_string(DATE_KEY, previous_date, MAX_DATE_CHAR);
+	if ( day == counters_day && date_string[0] ) {
+		return;
+	}
+	if ( day != counters_day ) {
+		reset_day();
+		update_points_display();
+	}
 
-		// if the stored date is not the same as the current date,
-		// reset counters
-		if ( strncmp(previous_date, date_string, strlen(previous_date)) ) {
-			reset_day();
+	// store date in date_string
+	strftime(date_string, MAX_DATE_CHAR, DATE_FORMAT, tm);
+	text_layer_set_text(date_text, date_string);
+}
 
-			// update current date
-			persist_write_string(DATE_KEY, date_string);
-		} 
-	} 
-	free(previous_date);
+// arms the timer for the next local midnight. the wait is worked out from
+// the local time of day, so on a day that a DST change makes longer it
+// fires an hour early and is armed again, and on a shorter one the minute
+// tick has rolled the day over before it fires
+static void schedule_midnight() {
+	time_t now = time(NULL);
+	struct tm *tm = localtime(&now);
+	int seconds = SECONDS_IN_DAY 
+		- (tm->tm_hour * 3600 + tm->tm_min * 60 + tm->tm_sec);
+
+	midnight_timer = app_timer_register(seconds * 1000, midnight_timeout, NULL);
+}
 
+static void midnight_timeout(void *data) {
+	time_t now = time(NULL);
+	refresh_day(localtime(&now));
+	schedule_midnight();
 }
 
 // called when there is a new day
 static void reset_day() {
 
+	// keep the day that is over in the history
+	HistoryDay day = {
+		.points = points_count,
+		.goal_met = goal_reached_today,
+		.minutes_worn = minutes_worn,
+		.active_minutes = active_minutes,
+	};
+	history_append(counters_day, &day);
+
 	// if the goal was not reached, reset the streak to 0
 	if ( !goal_reached_today ) {
 		streak = 0;
@@ -414,4 +526,90 @@ static void reset_day() {
 
 	points_count = 0;
 	goal_reached_today = 0;
+	minutes_worn = 0;
+	active_minutes = 0;
+	counters_day = today();
+
+	save_counters();
+	journal_flush();
+}
+
+// reads the counters from the journal. the first time, they are taken from
+// the keys they used to be written to, which are then dropped
+static void load_counters() {
+	int32_t counters[JOURNAL_COUNT];
+
+	journal_init(JOURNAL_KEY);
+	if ( journal_load(counters, JOURNAL_COUNT) ) {
+		points_count = counters[JOURNAL_POINTS];
+		streak = counters[JOURNAL_STREAK];
+		goal_reached_today = counters[JOURNAL_GOAL_REACHED];
+		record = counters[JOURNAL_RECORD];
+		best_streak = counters[JOURNAL_BEST_STREAK];
+		counters_day = counters[JOURNAL_DAY] ? counters[JOURNAL_DAY] : today();
+		minutes_worn = counters[JOURNAL_MINUTES_WORN];
+		active_minutes = counters[JOURNAL_ACTIVE_MINUTES];
+		return;
+	}
+
+	// the old keys only knew their day as the date they were shown under.
+	// counters from another date are taken as yesterday's, so the first
+	// refresh_day rolls them over and settles the streak
+	counters_day = today();
+	if ( persist_exists(DATE_KEY) ) {
+		char previous_date[MAX_DATE_CHAR] = "";
+		char current_date[MAX_DATE_CHAR];
+		time_t now = time(NULL);
+
+		strftime(current_date, MAX_DATE_CHAR, DATE_FORMAT, localtime(&now));
+		persist_read_string(DATE_KEY, previous_date, MAX_DATE_CHAR);
+		if ( strncmp(previous_date, current_date, strlen(previous_date)) ) {
+			counters_day--;
+		}
+	}
+
+	points_count = persist_exists(POINTS_COUNT_KEY) ? 
+		persist_read_int(POINTS_COUNT_KEY) : 0;
+	streak = persist_exists(STREAK_KEY) ? 
+		persist_read_int(STREAK_KEY) : 0;
+	goal_reached_today = persist_exists(GOAL_REACHED_KEY) ? 
+		persist_read_int(GOAL_REACHED_KEY) : 0;
+	record = persist_exists(RECORD_KEY) ? 
+		persist_read_int(RECORD_KEY) : 0;
+	best_streak = persist_exists(BEST_STREAK_KEY) ? 
+		persist_read_int(BEST_STREAK_KEY) : streak;
+
+	save_counters();
+	journal_flush();
+	persist_delete(DATE_KEY);
+	persist_delete(POINTS_COUNT_KEY);
+	persist_delete(STREAK_KEY);
+	persist_delete(GOAL_REACHED_KEY);
+	persist_delete(RECORD_KEY);
+	persist_delete(BEST_STREAK_KEY);
+}
+
+// hands the counters to the journal, which writes them behind
+static void save_counters() {
+	journal_set(JOURNAL_POINTS, points_count);
+	journal_set(JOURNAL_STREAK, streak);
+	journal_set(JOURNAL_GOAL_REACHED, goal_reached_today);
+	journal_set(JOURNAL_RECORD, record);
+	journal_set(JOURNAL_BEST_STREAK, best_streak);
+	journal_set(JOURNAL_DAY, counters_day);
+	journal_set(JOURNAL_MINUTES_WORN, minutes_worn);
+	journal_set(JOURNAL_ACTIVE_MINUTES, active_minutes);
+}
+
+// days since the epoch, in local time
+static int today() {
+	time_t now = time(NULL);
+	return local_day(localtime(&now));
+}
+
+// the day number of a local date, from the days in the years before it
+static int local_day(struct tm *tm) {
+	int year = tm->tm_year + 1900 - 1;
+	return year * 365 + year / 4 - year / 100 + year / 400 
+		+ tm->tm_yday - 719162;
 }
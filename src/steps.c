@@ -0,0 +1,124 @@
+/* ========================================================================== */
+/* File: steps.c
+ *
+ * Step detection on the raw accelerometer stream. Everything is integer
+ * math on a few words of static state, so it can run on every batch:
+ *
+ *   magnitude -> low-pass -> remove gravity -> adaptive-threshold peaks
+ *
+ * A step is a rising crossing of the threshold, at least STEP_MIN_MS after
+ * the previous one. The threshold follows half of a decaying peak envelope
+ * so it adapts to how hard the wearer is moving, with a floor that keeps
+ * sensor noise on a still wrist from counting.
+ */
+/* ========================================================================== */
+// ---------------- Open Issues
+
+// ---------------- System includes e.g., <stdio.h>
+#include <pebble.h>
+
+// ---------------- Local includes  e.g., "file.h"
+#include "steps.h"
+
+// ---------------- Constant definitions
+#define LOWPASS_SHIFT 1     // smoothing of the magnitude, ~1/2 new sample
+#define GRAVITY_SHIFT 5     // slow average that tracks the 1g baseline
+#define ENVELOPE_SHIFT 5    // decay of the peak envelope
+#define THRESHOLD_MIN 70    // mg above baseline; ignores a still wrist
+#define STEP_MIN_MS 250     // no more than four steps a second
+
+// ---------------- Private variables
+
+// all filter state is kept scaled by 2^4 for precision without floats
+static int32_t lowpass;
+static int32_t gravity;
+static int32_t envelope;
+static bool above;
+static bool primed;
+static uint64_t last_step_ms;
+static uint32_t total;
+static StepHandler step_handler;
+
+// ---------------- Private prototypes
+static uint32_t isqrt(uint32_t n);
+
+/* ========================================================================== */
+
+void steps_init(StepHandler handler) {
+	step_handler = handler;
+	lowpass = gravity = envelope = 0;
+	above = primed = false;
+	last_step_ms = 0;
+	total = 0;
+}
+
+uint32_t steps_total(void) {
+	return total;
+}
+
+void steps_process(AccelData *data, uint32_t num_samples) {
+	uint32_t found = 0;
+
+	for (uint32_t i = 0; i < num_samples; i++) {
+		int32_t x = data[i].x, y = data[i].y, z = data[i].z;
+		int32_t mag = isqrt(x * x + y * y + z * z) << 4;
+
+		// seed the filters on the first sample so they start settled
+		if (!primed) {
+			lowpass = gravity = mag;
+			primed = true;
+		}
+
+		lowpass += (mag - lowpass) >> LOWPASS_SHIFT;
+		gravity += (lowpass - gravity) >> GRAVITY_SHIFT;
+		int32_t signal = lowpass - gravity;
+
+		envelope -= envelope >> ENVELOPE_SHIFT;
+		if (signal > envelope) {
+			envelope = signal;
+		}
+		int32_t threshold = envelope / 2;
+		if (threshold < (THRESHOLD_MIN << 4)) {
+			threshold = THRESHOLD_MIN << 4;
+		}
+
+		// count on the rising edge, re-arm once the signal falls back
+		if (!above && signal > threshold) {
+			above = true;
+			uint64_t gap = data[i].timestamp - last_step_ms;
+			if (gap >= STEP_MIN_MS) {
+				found++;
+				last_step_ms = data[i].timestamp;
+			}
+		} else if (above && signal < threshold / 2) {
+			above = false;
+		}
+	}
+
+	if (found) {
+		total += found;
+		if (step_handler) {
+			step_handler(found);
+		}
+	}
+}
+
+// integer square root, enough for magnitudes of a few g in mg
+static uint32_t isqrt(uint32_t n) {
+	uint32_t root = 0;
+	uint32_t bit = 1u << 30;
+
+	while (bit > n) {
+		bit >>= 2;
+	}
+	while (bit) {
+		if (n >= root + bit) {
+			n -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return root;
+}
@@ -0,0 +1,19 @@
+/* ========================================================================== */
+/* File: steps.h
+ *
+ * Step detection on the accelerometer stream; see steps.c.
+ */
+/* ========================================================================== */
+#ifndef STEPS_H
+#define STEPS_H
+
+#include <pebble.h>
+
+// called with the number of steps found in each accelerometer batch
+typedef void (*StepHandler)(uint32_t steps);
+
+void steps_init(StepHandler handler);
+void steps_process(AccelData *data, uint32_t num_samples);
+uint32_t steps_total(void);
+
+#endif
@@ -16,6 +16,14 @@ limitations under the License.
 */
 
 #include <pebble.h>
+#include "frame.h"
+#include "feature.h"
+#include "classify.h"
+#include "outbox.h"
+#include "duty.h"
+#include "stats.h"
+#include "message.h"
+#include "accl.h"
 
 #define TupletStaticCString(_key, _cstring, _length) \
 ((const Tuplet) { .type = TUPLE_CSTRING, .key = _key, .cstring = { .data = _cstring, .length = _length + 1 }})
@@ -26,137 +34,407 @@ uint16_t sample_count=0;
 uint16_t acc_count=0;
 uint16_t ack_count=0;
 uint16_t fail_count=0;
+uint16_t drop_count=0;
 int16_t *acc_data;
 time_t   acc_time;
 uint8_t num_samples = 10; 
-static DictionaryIterator dict_iter, *iter = &dict_iter;
 char *xyz_str = "X,Y,Z:                      ";
-bool waiting_data = false;
-bool msg_run = false;
-
-#define timer_interval 100
-AppTimer *timer;
+static bool streaming = false;
+static AccelDataHandler accl_observer = NULL;
 
 #define KEY_OFFSET 48000
-#define T_TIME_BASE 1000  // string
-#define T_TS 1         // ints
-#define T_X 2          // ints
-#define T_Y 3          // ints
-#define T_Z 4          // ints
-#define T_DID_VIBRATE 5 // string T/F
 #define T_ACTIVITY 2000
 #define T_LOG 3000
-#define NUM_SAMPLES 10
+#define T_FRAME 4000   // bytes, see frame.h
+#define NUM_SAMPLES 10   // per ring slot; larger batches take several slots
+#define ACCL_BATCH_MAX 25  // the most the accel service delivers at once
 
-static char cur_activity[15];
+// number of batches held while the phone catches up; each costs ~170 bytes.
+// a message can hold most of the ring while the next batches fill the rest
+#ifndef ACCL_RING_DEPTH
+#define ACCL_RING_DEPTH 18
+#endif
 
-static AccelData accl_data[NUM_SAMPLES];
+// one frame, as much as the outbox message.h sizes has room for
+#define ACCL_FRAME_MAX_BYTES MSG_FRAME_MAX
 
-void request_send_acc(void) {
-	
-	uint16_t ms;
+// longest a batch waits for more batches to share its message
+#ifndef ACCL_FLUSH_DEADLINE_MS
+#define ACCL_FLUSH_DEADLINE_MS 4000
+#endif
+
+// feature windows held, and how many make a message worth sending
+#ifndef ACCL_WINDOW_DEPTH
+#define ACCL_WINDOW_DEPTH 12
+#endif
+#ifndef ACCL_WINDOWS_PER_MSG
+#define ACCL_WINDOWS_PER_MSG 6
+#endif
+
+// while the classifier has the watch still, a sample stream keeps only
+// one batch in this many; 1 keeps them all
+#ifndef ACCL_STILL_EVERY
+#define ACCL_STILL_EVERY 5
+#endif
+
+#ifndef ACCL_DEFAULT_MODE
+#define ACCL_DEFAULT_MODE ACCL_MODE_SAMPLES
+#endif
+
+_Static_assert(FRAME_DELTA_SIZE(NUM_SAMPLES) <= ACCL_FRAME_MAX_BYTES,
+	"a ring slot must always fit in a frame");
+_Static_assert(FRAME_HEADER_SIZE + ACCL_WINDOWS_PER_MSG * FRAME_FEATURE_SIZE
+	<= ACCL_FRAME_MAX_BYTES, "a message worth of windows must fit in a frame");
+
+typedef struct {
+	AccelData samples[NUM_SAMPLES];
+	uint8_t count;
+	uint8_t hz;
+} AcclBatch;
+
+static char cur_activity[MSG_ACTIVITY_MAX];
+static uint8_t activity = CLASSIFY_UNKNOWN;
+static uint8_t still_batches = 0;
+static uint8_t batch_size = NUM_SAMPLES;
+
+// batches waiting for the phone, oldest at ring_head. the head stays in the
+// ring until its message is acked so a failed send is retried, not lost.
+static AcclBatch accl_ring[ACCL_RING_DEPTH];
+static uint8_t ring_head = 0;
+static uint8_t ring_len = 0;
+
+// batches in the message awaiting an ack
+static uint8_t inflight_batches = 0;
+static uint32_t samples_sent = 0;
+
+// feature windows waiting for the phone, kept the same way as batches
+static uint8_t mode = ACCL_DEFAULT_MODE;
+static FeatureWindow win_ring[ACCL_WINDOW_DEPTH];
+static uint8_t win_hz[ACCL_WINDOW_DEPTH];
+static uint8_t win_head = 0;
+static uint8_t win_len = 0;
+static uint8_t inflight_windows = 0;
+
+// frames are built here, then copied into the outbox
+static uint8_t frame_buf[ACCL_FRAME_MAX_BYTES];
+
+// frame_buf holds the first packed_batches of the ring, packed_len bytes;
+// packed_batches is 0 when the ring changed since it was packed
+static Frame packed_frame;
+static uint8_t packed_batches = 0;
+static uint8_t packed_windows = 0;
+static uint16_t packed_len = 0;
+
+// true once the oldest queued batch has waited ACCL_FLUSH_DEADLINE_MS
+static bool flush_deadline_passed(void) {
+	if (ring_len == 0)
+		return false;
 	time_t now;
+	uint16_t ms;
 	time_ms(&now, &ms);
-	char buffer[15];
-	snprintf(buffer, sizeof(buffer) - 1, "%lu%03d", now, ms);
-	
-	// snprintf(xyz_str,22 ,"X,Y,Z: %d,%d,%d",acc_data[0],acc_data[1],acc_data[2] );
-	//APP_LOG(APP_LOG_LEVEL_DEBUG, "%s",xyz_str);
-	app_message_outbox_begin(&iter);
+	uint64_t now_ms = (uint64_t)now * 1000 + ms;
+	return now_ms >= accl_ring[ring_head].samples[0].timestamp + ACCL_FLUSH_DEADLINE_MS;
+}
 
-    long long nowz = now;
-    nowz = nowz * 1000 + ms;
+// packs as many queued batches as fit in one outbox message, oldest first;
+// a frame has one sampling rate, so a change of rate starts the next one
+static void pack_ring(void) {
+	uint8_t hz = accl_ring[ring_head].hz;
+	frame_begin(&packed_frame, frame_buf, sizeof(frame_buf), FRAME_ENC_DELTA, hz);
+	packed_batches = 0;
+	while (packed_batches < ring_len) {
+		AcclBatch *batch = &accl_ring[(ring_head + packed_batches) % ACCL_RING_DEPTH];
+		if (batch->hz != hz || !frame_add(&packed_frame, batch->samples, batch->count))
+			break;
+		packed_batches++;
+	}
+	// a single batch can always be delta coded within frame_buf
+	packed_len = frame_end(&packed_frame);
+}
 
-    
+// windows go once ACCL_WINDOWS_PER_MSG are queued or the stream is over
+static void pack_windows(void) {
+	uint8_t hz = win_hz[win_head];
+	frame_begin(&packed_frame, frame_buf, sizeof(frame_buf), FRAME_ENC_FEATURES, hz);
+	packed_windows = 0;
+	while (packed_windows < win_len) {
+		uint8_t i = (win_head + packed_windows) % ACCL_WINDOW_DEPTH;
+		if (win_hz[i] != hz || !frame_add_window(&packed_frame, &win_ring[i]))
+			break;
+		packed_windows++;
+	}
+	packed_len = frame_end(&packed_frame);
+}
 
-	Tuplet t = TupletStaticCString(KEY_OFFSET + T_TIME_BASE, buffer, strlen(buffer));
-	dict_write_tuplet(iter, &t);
+// holds a frame with room left unless the ring or the deadline says go
+static bool accl_ready(void) {
+	if (inflight_batches || inflight_windows)
+		return false;
+	if (ring_len) {
+		packed_windows = 0;
+		if (packed_batches == 0)
+			pack_ring();
+		// go while the ring can still take the batch that arrives in flight
+		uint8_t slots = (batch_size + NUM_SAMPLES - 1) / NUM_SAMPLES;
+		bool full = packed_batches < ring_len || ring_len + 2 * slots > ACCL_RING_DEPTH;
+		return full || flush_deadline_passed();
+	}
+	if (win_len) {
+		if (packed_windows == 0)
+			pack_windows();
+		return packed_windows < win_len || win_len >= ACCL_WINDOWS_PER_MSG || !streaming;
+	}
+	return false;
+}
+
+static uint16_t accl_depth(void) {
+	return ring_len + win_len;
+}
+
+static void accl_write(DictionaryIterator *iter) {
 	Tuplet act = TupletStaticCString(KEY_OFFSET + T_ACTIVITY, cur_activity, strlen(cur_activity));
 	dict_write_tuplet(iter, &act);
-    
-    for(int i = 0; i < NUM_SAMPLES; i++) {
-    
-        int point = KEY_OFFSET + (10 * i);
-        
-        Tuplet ts = TupletInteger(point + T_TS, (int)(nowz - accl_data[i].timestamp));
-        dict_write_tuplet(iter, &ts);
-        
-        Tuplet x = TupletInteger(point + T_X, accl_data[i].x);
-        dict_write_tuplet(iter, &x);
-
-        Tuplet y = TupletInteger(point + T_Y, accl_data[i].y);
-        dict_write_tuplet(iter, &y);
-
-        Tuplet z = TupletInteger(point + T_Z, accl_data[i].z);
-        dict_write_tuplet(iter, &z);
-
-        Tuplet dv = TupletStaticCString(point + T_DID_VIBRATE, accl_data[i].did_vibrate?"1":"0", 1);
-        dict_write_tuplet(iter, &dv);
 
+	Tuplet t = TupletBytes(KEY_OFFSET + T_FRAME, frame_buf, packed_len);
+	dict_write_tuplet(iter, &t);
+
+	if (packed_windows) {
+		inflight_windows = packed_windows;
+		acc_count++;
+		return;
 	}
-	
-	app_message_outbox_send();
-	waiting_data = false;
-	msg_run = true;
+	inflight_batches = packed_batches;
+	samples_sent += packed_frame.count;
 	acc_count++;
 }
 
-void timer_callback (void *data) {
-	
-	if ((waiting_data) && (msg_run==false))
-		request_send_acc(); 
-	timer = app_timer_register(timer_interval, timer_callback, NULL);
+// drops the acked batches from the front of the ring
+static void ring_pop(uint8_t n) {
+	if (n > ring_len)
+		n = ring_len;
+	ring_head = (ring_head + n) % ACCL_RING_DEPTH;
+	ring_len -= n;
+	packed_batches = 0;
 }
-void handle_second_tick(struct tm *tick_time, TimeUnits units_changed)
-{
-	// Need to be static because they're used by the system later.
-	static char count_text[] = "                                                                    ";
-
-	snprintf(count_text,sizeof(count_text) ,"sample:%03d \n   sent:  %03d \n   ack:   %03d \n   faild:  %03d", 
-		sample_count, acc_count, ack_count, fail_count);
-	if (acc_count %100==0)
-		APP_LOG(APP_LOG_LEVEL_INFO, "sample:%03d sent: %03d  ack: %03d  faild: %03d", 
-			sample_count, acc_count, ack_count, fail_count);
 
+static void accl_sent(void) {
+	ack_count++;
+	ring_pop(inflight_batches);
+	inflight_batches = 0;
+	win_head = (win_head + inflight_windows) % ACCL_WINDOW_DEPTH;
+	win_len -= inflight_windows;
+	inflight_windows = 0;
+	packed_windows = 0;
+	if (ack_count % 100 == 0)
+		APP_LOG(APP_LOG_LEVEL_INFO, "sample:%03d sent: %03d  ack: %03d  faild: %03d  drop: %03d  queued: %d  samples/msg: %d", 
+			sample_count, acc_count, ack_count, fail_count, drop_count, ring_len,
+			acc_count ? (int)(samples_sent / acc_count) : 0);
 }
-void out_failed_handler(DictionaryIterator *failed, AppMessageResult reason, void *context) {
+
+static void accl_failed(AppMessageResult reason) {
 	APP_LOG(APP_LOG_LEVEL_DEBUG, "App Message Failed to Send(%3d)! error: 0x%02X ",++fail_count,reason);
-	msg_run = false;
+	// the batches stay at the head of the ring and go out again on retry
+	inflight_batches = 0;
+	packed_batches = 0;
+	inflight_windows = 0;
+	packed_windows = 0;
+}
+
+static const OutboxSource accl_source = {
+	.priority = 0,
+	.deadline_ms = 2000,
+	.ready = accl_ready,
+	.depth = accl_depth,
+	.write = accl_write,
+	.sent = accl_sent,
+	.failed = accl_failed,
+};
 
+void request_send_acc(void) {
+	outbox_kick();
 }
-void out_received_handler(DictionaryIterator *iterator, void *context) {
-	//APP_LOG(APP_LOG_LEVEL_INFO, "App Message sent");
-	ack_count++;
-	msg_run = false;
+
+// every window is classified, streaming or not, and the label follows
+// the class as it changes. a window that ends inside a stream of windows
+// is queued like a batch
+static void window_done(const FeatureWindow *w) {
+	uint8_t c = classify_update(w);
+	if (c != activity) {
+		activity = c;
+		still_batches = 0;
+		accl_set_activity(classify_name(c));
+	}
+
+	if (!streaming || mode != ACCL_MODE_FEATURES)
+		return;
+	if (win_len == ACCL_WINDOW_DEPTH) {
+		drop_count++;
+		return;
+	}
+	win_ring[(win_head + win_len) % ACCL_WINDOW_DEPTH] = *w;
+	win_hz[(win_head + win_len) % ACCL_WINDOW_DEPTH] = sample_freq;
+	win_len++;
+	if (!inflight_windows)
+		packed_windows = 0;
 }
+
 void accel_data_handler(AccelData *data, uint32_t num_samples) {
+	STATS(stats_wakeup(STATS_WAKE_ACCEL));
+	STATS(uint64_t started = stats_clock());
 
-    for(uint32_t i = 0; i < num_samples; i++) {
-        accl_data[i].x = data[i].x;
-        accl_data[i].y = data[i].y;
-        accl_data[i].z = data[i].z;
-        accl_data[i].timestamp = data[i].timestamp;
-        accl_data[i].did_vibrate = data[i].did_vibrate;
-    }
-	acc_time=time(NULL);
-	waiting_data = true;
+	if (accl_observer)
+		accl_observer(data, num_samples);
+
+	// may start or stop the stream checked below
+	duty_process(data, num_samples);
+
+	feature_add(data, num_samples);
+
+	if (mode == ACCL_MODE_FEATURES) {
+		if (streaming || win_len)
+			outbox_kick();
+		STATS(stats_handler(STATS_H_ACCEL, started));
+		return;
+	}
+
+	// outside a streaming window the samples are only observed, but
+	// batches still queued go out as their deadline passes
+	if (!streaming) {
+		if (ring_len)
+			outbox_kick();
+		STATS(stats_handler(STATS_H_ACCEL, started));
+		return;
+	}
+
+	// a still watch sends a batch now and then to show it is still: the
+	// first one once it is still, then one in every ACCL_STILL_EVERY
+	if (activity == CLASSIFY_STILL) {
+		bool skip = still_batches != 0;
+		if (++still_batches == ACCL_STILL_EVERY)
+			still_batches = 0;
+		if (skip) {
+			if (ring_len)
+				outbox_kick();
+			STATS(stats_handler(STATS_H_ACCEL, started));
+			return;
+		}
+	}
 
 	sample_count++;
+	acc_time=time(NULL);
+
+	// the ring is full while the link is slow: keep what is queued, in
+	// order, and account for the batch we could not hold
+	if (ring_len == ACCL_RING_DEPTH) {
+		drop_count++;
+		outbox_kick();
+		STATS(stats_handler(STATS_H_ACCEL, started));
+		return;
+	}
+
+	if (num_samples > ACCL_BATCH_MAX)
+		num_samples = ACCL_BATCH_MAX;
+
+	// a batch larger than a ring slot fills several, each stamped with
+	// the rate it was taken at
+	for (uint32_t i = 0; i < num_samples; i += NUM_SAMPLES) {
+		if (ring_len == ACCL_RING_DEPTH) {
+			drop_count++;
+			break;
+		}
+		uint32_t n = num_samples - i < NUM_SAMPLES ? num_samples - i : NUM_SAMPLES;
+		AcclBatch *batch = &accl_ring[(ring_head + ring_len) % ACCL_RING_DEPTH];
+		memcpy(batch->samples, data + i, n * sizeof(AccelData));
+		batch->count = n;
+		batch->hz = sample_freq;
+		ring_len++;
+	}
+	// a new batch may fit in the packed frame; pack again when next asked,
+	// but not under a message in flight, which owns frame_buf
+	if (!inflight_batches)
+		packed_batches = 0;
+
+	// batches arrive every second, so this also covers the flush deadline
+	outbox_kick();
+	STATS(stats_handler(STATS_H_ACCEL, started));
 }
 
+// the accelerometer stays subscribed for the whole session so on-watch
+// consumers such as step counting always see it; streaming to the phone
+// is switched on and off separately
 void accl_init(void) {
-	tick_timer_service_subscribe(SECOND_UNIT, handle_second_tick);
-	accel_data_service_subscribe(10, &accel_data_handler);
+	accel_data_service_subscribe(batch_size, &accel_data_handler);
 	accel_service_set_sampling_rate(sample_freq); //This is the place that works
-	
-	app_message_register_outbox_failed(out_failed_handler);
-	app_message_register_outbox_sent(out_received_handler);
 
-    timer = app_timer_register(timer_interval, timer_callback, NULL);
-	app_comm_set_sniff_interval(SNIFF_INTERVAL_REDUCED);
+	feature_init(window_done);
+	feature_set_rate(sample_freq);
+	classify_reset();
+	activity = CLASSIFY_UNKNOWN;
+	still_batches = 0;
+	accl_set_activity(classify_name(activity));
+	outbox_register(OUTBOX_SRC_ACCL, &accl_source);
 }
 
 void accl_deinit(void) {
-	tick_timer_service_unsubscribe();
+	accl_stream_stop();
+	accel_data_service_unsubscribe();
+}
+
+// what is already queued still goes; the next window starts afresh
+void accl_set_mode(uint8_t m) {
+	if (m == mode)
+		return;
+	mode = m;
+	feature_reset();
+}
+
+// the sampling rate, 10, 25, 50 or 100 Hz. samples already queued keep
+// theirs; the window being built is dropped, since it would mix the two
+bool accl_set_rate(uint8_t hz) {
+	if (hz != ACCEL_SAMPLING_10HZ && hz != ACCEL_SAMPLING_25HZ
+			&& hz != ACCEL_SAMPLING_50HZ && hz != ACCEL_SAMPLING_100HZ)
+		return false;
+	if (hz == sample_freq)
+		return true;
+	sample_freq = hz;
+	accel_service_set_sampling_rate(hz);
+	feature_set_rate(hz);
+	return true;
+}
+
+// samples per batch, which sets how often the watch wakes for them
+bool accl_set_batch(uint8_t n) {
+	if (n < 1 || n > ACCL_BATCH_MAX)
+		return false;
+	if (n == batch_size)
+		return true;
+	batch_size = n;
+	accel_service_set_samples_per_update(n);
+	return true;
+}
+
+// the label sent with every message; the classifier sets it on each change
+// of class, so one set here stands until the next
+void accl_set_activity(const char *act) {
+	strncpy(cur_activity, act, sizeof(cur_activity) - 1);
+}
+
+void accl_set_observer(AccelDataHandler handler) {
+	accl_observer = handler;
+}
+
+void accl_stream_start(void) {
+	if (streaming)
+		return;
+	streaming = true;
+	app_comm_set_sniff_interval(SNIFF_INTERVAL_REDUCED);
+	STATS(stats_sniff(true));
+}
+
+void accl_stream_stop(void) {
+	if (!streaming)
+		return;
+	streaming = false;
 	app_comm_set_sniff_interval(SNIFF_INTERVAL_NORMAL);
+	STATS(stats_sniff(false));
 }
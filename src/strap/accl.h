@@ -1,3 +1,20 @@
+#ifndef ACCL_H
+#define ACCL_H
+
+// what a stream sends: every sample, or a feature window (feature.h) for
+// every FEATURE_WINDOW_MS of them
+#define ACCL_MODE_SAMPLES 0
+#define ACCL_MODE_FEATURES 1
+
 void accl_init(void);
 void accl_deinit(void);
-void request_send_acc(void);
\ No newline at end of file
+void accl_set_observer(AccelDataHandler);
+void accl_stream_start(void);
+void accl_stream_stop(void);
+void accl_set_mode(uint8_t mode);
+void accl_set_activity(const char *act);
+bool accl_set_rate(uint8_t hz);
+bool accl_set_batch(uint8_t n);
+void request_send_acc(void);
+
+#endif
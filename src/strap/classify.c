@@ -0,0 +1,101 @@
+/*
+Copyright 2014 EnSens, LLC D/B/A Strap
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <pebble.h>
+#include "feature.h"
+#include "classify.h"
+
+#define LEAF 0xff
+
+// a node sends a window below its threshold one way and at or above it
+// the other; a leaf (feature LEAF) names the class in below
+typedef struct {
+	uint8_t feature;
+	int16_t threshold;
+	uint8_t below;
+	uint8_t above;
+} ClassifyNode;
+
+// fit with tools/host/eval_classify --vary on the synthetic traces; refit
+// from its --features output when there are labeled traces from the wrist
+static const ClassifyNode tree[] = {
+	/* 0 */ { CLASSIFY_F_MAG_STD, 25, 1, 2 },
+	/* 1 */ { LEAF, 0, CLASSIFY_STILL, 0 },
+	/* 2 */ { CLASSIFY_F_TILT, 250, 5, 3 },
+	/* 3 */ { CLASSIFY_F_MAG_STD, 130, 4, 5 },
+	/* 4 */ { LEAF, 0, CLASSIFY_CYCLE, 0 },
+	/* 5 */ { CLASSIFY_F_MAG_STD, 360, 6, 7 },
+	/* 6 */ { LEAF, 0, CLASSIFY_WALK, 0 },
+	/* 7 */ { LEAF, 0, CLASSIFY_RUN, 0 },
+};
+
+static const char *names[CLASSIFY_CLASSES] = {
+	"UNKNOWN", "STILL", "WALK", "RUN", "CYCLE",
+};
+
+static uint8_t current = CLASSIFY_UNKNOWN;
+static uint8_t candidate = CLASSIFY_UNKNOWN;
+static uint8_t agreed = 0;
+
+void classify_reset(void) {
+	current = CLASSIFY_UNKNOWN;
+	candidate = CLASSIFY_UNKNOWN;
+	agreed = 0;
+}
+
+static int16_t clamp16(int32_t v) {
+	return v > INT16_MAX ? INT16_MAX : v;
+}
+
+void classify_features(const FeatureWindow *w, int16_t *f) {
+	f[CLASSIFY_F_MAG_STD] = clamp16(feature_isqrt(w->mag_var));
+	f[CLASSIFY_F_DOM_BAND] = w->dominant;
+	f[CLASSIFY_F_DOM_AMP] = clamp16(w->bins[w->dominant]);
+	f[CLASSIFY_F_CROSSINGS] = w->crossings;
+	f[CLASSIFY_F_TILT] = clamp16(abs(w->mean[0]) + abs(w->mean[1]));
+}
+
+uint8_t classify_window(const FeatureWindow *w) {
+	int16_t f[CLASSIFY_FEATURES];
+	classify_features(w, f);
+	uint8_t i = 0;
+	while (tree[i].feature != LEAF) {
+		i = f[tree[i].feature] < tree[i].threshold ? tree[i].below : tree[i].above;
+	}
+	return tree[i].below;
+}
+
+// the class of the latest CLASSIFY_HOLD windows, once they agree
+uint8_t classify_update(const FeatureWindow *w) {
+	uint8_t c = classify_window(w);
+	if (c == current) {
+		agreed = 0;
+		return current;
+	}
+	if (c != candidate) {
+		candidate = c;
+		agreed = 0;
+	}
+	if (++agreed >= CLASSIFY_HOLD) {
+		current = c;
+		agreed = 0;
+	}
+	return current;
+}
+
+const char *classify_name(uint8_t c) {
+	return c < CLASSIFY_CLASSES ? names[c] : names[CLASSIFY_UNKNOWN];
+}
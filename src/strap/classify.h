@@ -0,0 +1,39 @@
+#ifndef CLASSIFY_H
+#define CLASSIFY_H
+
+/*
+Labels feature windows (feature.h) as still, walking, running or cycling
+with a small decision tree kept as a const table. The tree looks at a few
+integers taken from the window, CLASSIFY_F_*, and its thresholds are in
+the same units, so classifying a window is a handful of compares.
+
+A new class only takes over once CLASSIFY_HOLD windows in a row agree, so
+a single odd window does not flip the label.
+*/
+
+#define CLASSIFY_UNKNOWN 0
+#define CLASSIFY_STILL 1
+#define CLASSIFY_WALK 2
+#define CLASSIFY_RUN 3
+#define CLASSIFY_CYCLE 4
+#define CLASSIFY_CLASSES 5
+
+#ifndef CLASSIFY_HOLD
+#define CLASSIFY_HOLD 2
+#endif
+
+// what the tree sees of a window
+#define CLASSIFY_F_MAG_STD 0      // magnitude standard deviation, mg
+#define CLASSIFY_F_DOM_BAND 1     // the strongest band
+#define CLASSIFY_F_DOM_AMP 2      // its amplitude, mg
+#define CLASSIFY_F_CROSSINGS 3
+#define CLASSIFY_F_TILT 4         // |mean x| + |mean y|, mg
+#define CLASSIFY_FEATURES 5
+
+void classify_reset(void);
+void classify_features(const FeatureWindow *w, int16_t *f);
+uint8_t classify_window(const FeatureWindow *w);
+uint8_t classify_update(const FeatureWindow *w);
+const char *classify_name(uint8_t c);
+
+#endif
@@ -0,0 +1,104 @@
+/*
+Copyright 2014 EnSens, LLC D/B/A Strap
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <pebble.h>
+#include "accl.h"
+#include "duty.h"
+#include "config.h"
+
+#define KEY_OFFSET 48000
+
+#define DUTY_MAX_S (24 * 60 * 60)
+
+// the phone sends integers at whatever width it likes
+static bool read_int(DictionaryIterator *iter, uint32_t key, int32_t *v) {
+	Tuple *t = dict_find(iter, KEY_OFFSET + key);
+	if (!t) {
+		return false;
+	}
+	if (t->type == TUPLE_INT) {
+		*v = t->length == 1 ? t->value->int8
+			: t->length == 2 ? t->value->int16 : t->value->int32;
+	} else if (t->type == TUPLE_UINT) {
+		*v = t->length == 1 ? t->value->uint8
+			: t->length == 2 ? t->value->uint16 : (int32_t)t->value->uint32;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+// a duration in seconds, as ms, when it is present and sensible
+static bool read_seconds(DictionaryIterator *iter, uint32_t key, uint32_t *ms) {
+	int32_t s;
+	if (!read_int(iter, key, &s) || s <= 0 || s > DUTY_MAX_S) {
+		return false;
+	}
+	*ms = s * 1000;
+	return true;
+}
+
+// true when the message held settings, whether or not they were all valid
+bool config_apply(DictionaryIterator *iter) {
+	bool found = false;
+	int32_t v;
+
+	if (read_int(iter, T_CFG_RATE, &v)) {
+		found = true;
+		if (v < 0 || v > UINT8_MAX || !accl_set_rate(v)) {
+			APP_LOG(APP_LOG_LEVEL_WARNING, "config: no rate %d Hz", (int)v);
+		}
+	}
+	if (read_int(iter, T_CFG_BATCH, &v)) {
+		found = true;
+		if (v < 0 || v > UINT8_MAX || !accl_set_batch(v)) {
+			APP_LOG(APP_LOG_LEVEL_WARNING, "config: no batch of %d", (int)v);
+		}
+	}
+	if (read_int(iter, T_CFG_MODE, &v)) {
+		found = true;
+		if (v == ACCL_MODE_SAMPLES || v == ACCL_MODE_FEATURES) {
+			accl_set_mode(v);
+		}
+	}
+
+	DutyConfig duty;
+	duty_get_config(&duty);
+	bool duty_found = false;
+	if (read_int(iter, T_CFG_ACTIVE_MG, &v)) {
+		duty_found = true;
+		if (v > 0 && v <= 4000) {
+			duty.active_mg = v;
+		}
+	}
+	if (read_int(iter, T_CFG_BUDGET_PERMILLE, &v)) {
+		duty_found = true;
+		if (v > 0 && v <= 1000) {
+			duty.budget_permille = v;
+		}
+	}
+	duty_found |= read_seconds(iter, T_CFG_WINDOW_S, &duty.window_ms);
+	duty_found |= read_seconds(iter, T_CFG_STILL_S, &duty.still_ms);
+	duty_found |= read_seconds(iter, T_CFG_PROBE_S, &duty.probe_ms);
+	duty_found |= read_seconds(iter, T_CFG_IDLE_MIN_S, &duty.idle_min_ms);
+	duty_found |= read_seconds(iter, T_CFG_IDLE_MAX_S, &duty.idle_max_ms);
+	duty_found |= read_seconds(iter, T_CFG_BUDGET_CAP_S, &duty.budget_cap_ms);
+	if (duty_found) {
+		duty_configure(&duty);
+	}
+
+	return found || duty_found;
+}
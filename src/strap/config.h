@@ -0,0 +1,28 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+/*
+Settings the phone pushes to the watch inbox, applied as they arrive with
+no restart. Each is an integer under KEY_OFFSET + T_CFG_*, and a message
+carries any subset of them; anything missing keeps its current value and
+anything out of range is ignored. The rate goes out in the header of every
+frame (frame.h), so the phone can decode without knowing what it asked
+for. strap_api_configure in pebble-js-app.js is the sending side.
+*/
+
+#define T_CFG_RATE 5000             // Hz: 10, 25, 50 or 100
+#define T_CFG_BATCH 5001            // samples per batch, 1 to 25
+#define T_CFG_MODE 5002             // STRAP_ACCEL_SAMPLES or STRAP_ACCEL_FEATURES
+#define T_CFG_ACTIVE_MG 5010        // the DutyConfig fields (duty.h),
+#define T_CFG_WINDOW_S 5011         // times in seconds
+#define T_CFG_STILL_S 5012
+#define T_CFG_PROBE_S 5013
+#define T_CFG_IDLE_MIN_S 5014
+#define T_CFG_IDLE_MAX_S 5015
+#define T_CFG_BUDGET_PERMILLE 5016
+#define T_CFG_BUDGET_CAP_S 5017
+#define CONFIG_KEYS 11              // the T_CFG_* above
+
+bool config_apply(DictionaryIterator *iter);
+
+#endif
@@ -0,0 +1,182 @@
+/*
+Copyright 2014 EnSens, LLC D/B/A Strap
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <pebble.h>
+#include "accl.h"
+#include "duty.h"
+
+#define ENERGY_SHIFT 2        // smoothing across batches, ~1/4 new batch
+#define MAX_GAP_MS 5000       // longest stretch credited between batches
+
+static bool enabled = false;
+static bool streaming = false;
+static bool probing = false;  // the stream is a probe of a still watch
+static bool moved = false;    // motion seen during this stream
+static int freq = 1;
+
+static DutyConfig cfg = {
+	.active_mg = DUTY_ACTIVE_MG,
+	.window_ms = DUTY_WINDOW_MS,
+	.still_ms = DUTY_STILL_MS,
+	.probe_ms = DUTY_PROBE_MS,
+	.idle_min_ms = DUTY_IDLE_MIN_MS,
+	.idle_max_ms = DUTY_IDLE_MAX_MS,
+	.budget_permille = DUTY_BUDGET_PERMILLE,
+	.budget_cap_ms = DUTY_BUDGET_CAP_MS,
+};
+
+static int32_t energy = 0;    // mg, scaled by 2^4
+static uint64_t last_ms = 0;
+static uint64_t since_ms = 0;         // when the stream started
+static uint64_t active_ms = 0;        // last batch above cfg.active_mg
+static uint64_t next_probe_ms = 0;
+static uint32_t first_probe = 0;
+static uint32_t idle_ms = DUTY_IDLE_MIN_MS;
+static int32_t budget_ms = DUTY_BUDGET_CAP_MS;
+
+void duty_init(uint32_t first_probe_ms) {
+	enabled = true;
+	streaming = probing = moved = false;
+	energy = 0;
+	last_ms = 0;
+	first_probe = first_probe_ms;
+	idle_ms = cfg.idle_min_ms;
+	budget_ms = cfg.budget_cap_ms;
+}
+
+void duty_get_config(DutyConfig *config) {
+	*config = cfg;
+}
+
+// takes effect from the next batch; a stream under way is judged by the
+// new limits, and the idle period and budget are brought within them
+void duty_configure(const DutyConfig *config) {
+	cfg = *config;
+	if (cfg.idle_max_ms < cfg.idle_min_ms) {
+		cfg.idle_max_ms = cfg.idle_min_ms;
+	}
+	if (idle_ms < cfg.idle_min_ms) {
+		idle_ms = cfg.idle_min_ms;
+	} else if (idle_ms > cfg.idle_max_ms) {
+		idle_ms = cfg.idle_max_ms;
+	}
+	if (budget_ms > (int32_t)cfg.budget_cap_ms) {
+		budget_ms = cfg.budget_cap_ms;
+	}
+}
+
+void duty_set_freq(int f) {
+	freq = f > 0 ? f : 1;
+}
+
+uint32_t duty_energy(void) {
+	return energy >> 4;
+}
+
+// mean absolute deviation of each axis within the batch, summed
+static uint32_t batch_energy(AccelData *data, uint32_t n) {
+	int32_t sum[3] = { 0, 0, 0 };
+	for (uint32_t i = 0; i < n; i++) {
+		sum[0] += data[i].x;
+		sum[1] += data[i].y;
+		sum[2] += data[i].z;
+	}
+	uint32_t dev = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		dev += abs(data[i].x - sum[0] / (int32_t)n);
+		dev += abs(data[i].y - sum[1] / (int32_t)n);
+		dev += abs(data[i].z - sum[2] / (int32_t)n);
+	}
+	return dev / n;
+}
+
+static void start(uint64_t now, bool probe) {
+	streaming = true;
+	probing = probe;
+	moved = !probe;
+	since_ms = now;
+	accl_stream_start();
+}
+
+static void stop(uint64_t now) {
+	streaming = false;
+	accl_stream_stop();
+
+	// a still probe backs the next one off; motion resets the period
+	if (moved) {
+		idle_ms = cfg.idle_min_ms;
+	} else if (idle_ms < cfg.idle_max_ms / 2) {
+		idle_ms *= 2;
+	} else {
+		idle_ms = cfg.idle_max_ms;
+	}
+	next_probe_ms = now + (uint64_t)idle_ms * freq;
+}
+
+void duty_process(AccelData *data, uint32_t num_samples) {
+	if (!enabled || num_samples == 0) {
+		return;
+	}
+	uint64_t now = data[num_samples - 1].timestamp;
+	if (last_ms == 0) {
+		last_ms = now;
+		next_probe_ms = now + first_probe;
+	}
+
+	// refill the budget for the time since the last batch, spend on streaming
+	uint32_t dt = now - last_ms < MAX_GAP_MS ? now - last_ms : MAX_GAP_MS;
+	last_ms = now;
+	budget_ms += dt * cfg.budget_permille / 1000;
+	if (streaming) {
+		budget_ms -= dt;
+	}
+	if (budget_ms > (int32_t)cfg.budget_cap_ms) {
+		budget_ms = cfg.budget_cap_ms;
+	}
+
+	int32_t e = batch_energy(data, num_samples) << 4;
+	energy += (e - energy) >> ENERGY_SHIFT;
+	bool active = energy > ((int32_t)cfg.active_mg << 4);
+	if (active) {
+		active_ms = now;
+	}
+
+	if (!streaming) {
+		if (budget_ms < (int32_t)cfg.probe_ms) {
+			return;
+		}
+		if (active) {
+			start(now, false);
+		} else if (now >= next_probe_ms) {
+			start(now, true);
+		}
+		return;
+	}
+
+	if (active && probing) {
+		// the probe caught the start of activity; keep it going
+		probing = false;
+		moved = true;
+		since_ms = now;
+	}
+	uint64_t length = now - since_ms;
+	if (budget_ms <= 0
+			|| (probing && length >= cfg.probe_ms)
+			|| (!probing && length >= cfg.window_ms
+				&& now - active_ms >= cfg.still_ms)) {
+		stop(now);
+	}
+}
@@ -0,0 +1,68 @@
+#ifndef DUTY_H
+#define DUTY_H
+
+/*
+Decides when accelerometer data is streamed to the phone.
+
+The accelerometer runs for the whole session, so every batch updates a
+cheap motion-energy estimate: the mean absolute deviation of each axis
+within the batch, summed over the axes and smoothed across batches.
+
+  - Motion above DUTY_ACTIVE_MG starts a stream straight away. It lasts
+    at least DUTY_WINDOW_MS and ends after DUTY_STILL_MS without motion.
+  - A still watch is only probed: DUTY_PROBE_MS of data, then an idle
+    period that doubles after every still probe, from DUTY_IDLE_MIN_MS
+    (times the strap frequency multiplier) up to DUTY_IDLE_MAX_MS.
+  - Streaming draws on a budget that refills at DUTY_BUDGET_PERMILLE of
+    wall time, up to DUTY_BUDGET_CAP_MS. No stream starts with less than
+    DUTY_PROBE_MS in hand, and an empty budget ends the stream.
+
+Everything is evaluated as batches arrive; the controller has no timers.
+The DUTY_* values are the defaults of a DutyConfig, which the phone can
+replace at runtime (config.h).
+*/
+
+#ifndef DUTY_ACTIVE_MG
+#define DUTY_ACTIVE_MG 60
+#endif
+#ifndef DUTY_WINDOW_MS
+#define DUTY_WINDOW_MS (60 * 1000)
+#endif
+#ifndef DUTY_STILL_MS
+#define DUTY_STILL_MS (20 * 1000)
+#endif
+#ifndef DUTY_PROBE_MS
+#define DUTY_PROBE_MS (10 * 1000)
+#endif
+#ifndef DUTY_IDLE_MIN_MS
+#define DUTY_IDLE_MIN_MS (2 * 60 * 1000)
+#endif
+#ifndef DUTY_IDLE_MAX_MS
+#define DUTY_IDLE_MAX_MS (30 * 60 * 1000)
+#endif
+#ifndef DUTY_BUDGET_PERMILLE
+#define DUTY_BUDGET_PERMILLE 400
+#endif
+#ifndef DUTY_BUDGET_CAP_MS
+#define DUTY_BUDGET_CAP_MS (15 * 60 * 1000)
+#endif
+
+typedef struct {
+	uint16_t active_mg;
+	uint32_t window_ms;
+	uint32_t still_ms;
+	uint32_t probe_ms;
+	uint32_t idle_min_ms;
+	uint32_t idle_max_ms;
+	uint16_t budget_permille;
+	uint32_t budget_cap_ms;
+} DutyConfig;
+
+void duty_init(uint32_t first_probe_ms);
+void duty_get_config(DutyConfig *config);
+void duty_configure(const DutyConfig *config);
+void duty_set_freq(int freq);
+void duty_process(AccelData *data, uint32_t num_samples);
+uint32_t duty_energy(void);
+
+#endif
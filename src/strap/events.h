@@ -0,0 +1,24 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+/*
+The log events in events.def, as codes. A logged event is queued and
+spooled as a StrapEvent: a code and its number, or STRAP_EV_PATH and a
+path for events that are not in the table.
+*/
+
+typedef enum {
+#define STRAP_EVENT(name, path, has_arg) STRAP_EV_##name,
+#include "events.def"
+#undef STRAP_EVENT
+	STRAP_EV_COUNT,
+	STRAP_EV_PATH = 0xff
+} StrapEventId;
+
+typedef struct {
+	uint8_t id;
+	uint16_t arg;
+	const char *path;  // STRAP_EV_PATH only
+} StrapEvent;
+
+#endif
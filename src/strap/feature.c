@@ -0,0 +1,245 @@
+/*
+Copyright 2014 EnSens, LLC D/B/A Strap
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <pebble.h>
+#include "feature.h"
+
+#define COEFF_SHIFT 14  // Goertzel coefficients are 2 cos(w) in Q14
+
+static FeatureHandler handler = NULL;
+static int32_t coeff[FEATURE_BINS];
+static uint8_t window;      // samples in a window, after averaging
+static uint8_t stride;      // samples averaged into one
+
+// samples waiting to be averaged into the next one
+static uint8_t pending = 0;
+static int32_t pending_sum[3];
+static uint64_t pending_ms;
+
+// the window being built
+static uint64_t start_ms;
+static uint8_t n = 0;
+static int32_t sum[3];
+static uint64_t sumsq[3];
+static int16_t lo[3], hi[3];
+static uint32_t mag_sum;
+static uint64_t mag_sumsq;
+static uint16_t mag_lo, mag_hi;
+static uint8_t crossings;
+static bool above;
+static int32_t s1[FEATURE_BINS], s2[FEATURE_BINS];
+
+// the previous window's mean magnitude; -1 until there is one
+static int32_t ref = -1;
+
+void feature_init(FeatureHandler h) {
+	handler = h;
+	feature_set_rate(ACCEL_SAMPLING_10HZ);
+}
+
+// drops the window being built, for a break in the samples
+void feature_reset(void) {
+	n = 0;
+	pending = 0;
+	ref = -1;
+}
+
+// windows of FEATURE_WINDOW_MS at hz; the window being built is dropped
+void feature_set_rate(uint8_t hz) {
+	uint32_t samples = (uint32_t)hz * FEATURE_WINDOW_MS / 1000;
+	stride = 1;
+	while (samples / stride > FEATURE_WINDOW_MAX) {
+		stride *= 2;
+	}
+	window = samples / stride ? samples / stride : 1;
+	for (int i = 0; i < FEATURE_BINS; i++) {
+		int32_t k = FEATURE_BIN_FIRST + i * FEATURE_BIN_STEP;
+		coeff[i] = (int32_t)(2 * (int64_t)cos_lookup(TRIG_MAX_ANGLE * k / window)
+			* (1 << COEFF_SHIFT) / TRIG_MAX_RATIO);
+	}
+	feature_reset();
+}
+
+uint8_t feature_window(void) {
+	return window;
+}
+
+// bit by bit, two result bits per step
+uint32_t feature_isqrt(uint64_t v) {
+	uint64_t root = 0;
+	uint64_t bit = (uint64_t)1 << 62;
+	while (bit > v) {
+		bit >>= 2;
+	}
+	while (bit) {
+		if (v >= root + bit) {
+			v -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return root;
+}
+
+// the same for the 26 bits a squared magnitude needs, on the per sample
+// path, rounded to nearest
+static uint32_t isqrt32(uint32_t v) {
+	uint32_t root = 0;
+	uint32_t bit = 1u << 26;
+	while (bit > v) {
+		bit >>= 2;
+	}
+	while (bit) {
+		if (v >= root + bit) {
+			v -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return v > root ? root + 1 : root;
+}
+
+// (sum of squares - sum^2 / n) / n, rounded down
+static uint32_t variance(uint64_t sq, int64_t s, uint8_t count) {
+	uint64_t d = sq * count - (uint64_t)(s * s);
+	return d / ((uint32_t)count * count);
+}
+
+static int32_t rounded_mean(int64_t s, uint8_t count) {
+	return (s >= 0 ? s + count / 2 : s - count / 2) / count;
+}
+
+static void begin(uint64_t ms) {
+	start_ms = ms;
+	memset(sum, 0, sizeof(sum));
+	memset(sumsq, 0, sizeof(sumsq));
+	mag_sum = 0;
+	mag_sumsq = 0;
+	crossings = 0;
+	memset(s1, 0, sizeof(s1));
+	memset(s2, 0, sizeof(s2));
+}
+
+static void finish(void) {
+	FeatureWindow w;
+	w.start_ms = start_ms;
+	w.count = n;
+	for (int a = 0; a < 3; a++) {
+		w.mean[a] = rounded_mean(sum[a], n);
+		w.var[a] = variance(sumsq[a], sum[a], n);
+		w.p2p[a] = hi[a] - lo[a];
+	}
+	w.mag_mean = rounded_mean(mag_sum, n);
+	w.mag_var = variance(mag_sumsq, mag_sum, n);
+	w.mag_p2p = mag_hi - mag_lo;
+	w.crossings = crossings;
+
+	// |X|^2 = s1^2 + s2^2 - c s1 s2, and a sine of amplitude A has |X| = A n / 2
+	w.dominant = 0;
+	for (int i = 0; i < FEATURE_BINS; i++) {
+		int64_t power = (int64_t)s1[i] * s1[i] + (int64_t)s2[i] * s2[i]
+			- (((int64_t)coeff[i] * s1[i]) >> COEFF_SHIFT) * s2[i];
+		uint32_t amp = 2 * feature_isqrt(power > 0 ? power : 0) / n;
+		w.bins[i] = amp < UINT16_MAX ? amp : UINT16_MAX;
+		if (w.bins[i] > w.bins[w.dominant]) {
+			w.dominant = i;
+		}
+	}
+
+	ref = w.mag_mean;
+	n = 0;
+	if (handler) {
+		handler(&w);
+	}
+}
+
+static void add_sample(int16_t x, int16_t y, int16_t z, uint64_t ms) {
+	int16_t axis[3] = { x, y, z };
+	uint16_t mag = isqrt32((int32_t)x * x + (int32_t)y * y + (int32_t)z * z);
+
+	if (n == 0) {
+		begin(ms);
+		for (int a = 0; a < 3; a++) {
+			lo[a] = hi[a] = axis[a];
+		}
+		mag_lo = mag_hi = mag;
+		if (ref < 0) {
+			ref = mag;
+		}
+		above = mag > ref;
+	}
+
+	for (int a = 0; a < 3; a++) {
+		sum[a] += axis[a];
+		sumsq[a] += (int32_t)axis[a] * axis[a];
+		if (axis[a] < lo[a]) {
+			lo[a] = axis[a];
+		} else if (axis[a] > hi[a]) {
+			hi[a] = axis[a];
+		}
+	}
+	mag_sum += mag;
+	mag_sumsq += (uint32_t)mag * mag;
+	if (mag < mag_lo) {
+		mag_lo = mag;
+	} else if (mag > mag_hi) {
+		mag_hi = mag;
+	}
+
+	int32_t v = mag - ref;
+	if (above ? v < -FEATURE_CROSS_MG : v > FEATURE_CROSS_MG) {
+		above = !above;
+		crossings++;
+	}
+
+	for (int b = 0; b < FEATURE_BINS; b++) {
+		int32_t s0 = v + (int32_t)(((int64_t)coeff[b] * s1[b]) >> COEFF_SHIFT) - s2[b];
+		s2[b] = s1[b];
+		s1[b] = s0;
+	}
+
+	if (++n == window) {
+		finish();
+	}
+}
+
+void feature_add(const AccelData *data, uint32_t num_samples) {
+	for (uint32_t i = 0; i < num_samples; i++) {
+		const AccelData *s = &data[i];
+		if (stride == 1) {
+			add_sample(s->x, s->y, s->z, s->timestamp);
+			continue;
+		}
+
+		if (pending == 0) {
+			pending_ms = s->timestamp;
+			memset(pending_sum, 0, sizeof(pending_sum));
+		}
+		pending_sum[0] += s->x;
+		pending_sum[1] += s->y;
+		pending_sum[2] += s->z;
+		if (++pending == stride) {
+			pending = 0;
+			add_sample(rounded_mean(pending_sum[0], stride),
+				rounded_mean(pending_sum[1], stride),
+				rounded_mean(pending_sum[2], stride), pending_ms);
+		}
+	}
+}
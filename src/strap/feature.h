@@ -0,0 +1,73 @@
+#ifndef FEATURE_H
+#define FEATURE_H
+
+/*
+A summary of the accelerometer over windows of FEATURE_WINDOW_MS,
+for sending in place of the samples themselves. It is built up sample by
+sample in integer arithmetic as batches arrive, and handed to the handler
+when a window fills.
+
+For each axis: mean, variance and peak-to-peak. For the magnitude of the
+three: mean, variance and peak-to-peak, how many times it crossed its
+mean, and its amplitude in FEATURE_BINS frequency bands, from a Goertzel
+filter per band.
+
+Crossings and bands are measured about the previous window's mean
+magnitude, since this window's is not known until it ends, and a crossing
+has to pass it by FEATURE_CROSS_MG so noise on a still watch does not
+count. The bands are whole cycles per window, FEATURE_BIN_FIRST then every
+FEATURE_BIN_STEP, which over 5 s is 0.6 Hz to 3.4 Hz in steps of 0.4 Hz,
+the range of walking and running cadence.
+
+feature_set_rate() sizes the window in samples to keep its length in time,
+so the bands, the crossing counts and the classifier thresholds fitted at
+10 Hz mean the same at every rate. A window holds at most
+FEATURE_WINDOW_MAX samples, the most a frame records, so above that rate
+consecutive samples are averaged in pairs: 100 Hz is summarized as 250
+samples at 50 Hz. Faster sampling still sees more of the sensor's noise,
+which raises the variances and peak-to-peak values a little against the
+10 Hz data the thresholds were fitted to; the frame header carries the
+rate (frame.h) so the phone can tell.
+*/
+
+#ifndef FEATURE_WINDOW_MS
+#define FEATURE_WINDOW_MS 5000
+#endif
+#define FEATURE_WINDOW_MAX 255  // samples
+
+#ifndef FEATURE_CROSS_MG
+#define FEATURE_CROSS_MG 8
+#endif
+
+#define FEATURE_BINS 8
+#ifndef FEATURE_BIN_FIRST
+#define FEATURE_BIN_FIRST 3  // cycles per window
+#endif
+#ifndef FEATURE_BIN_STEP
+#define FEATURE_BIN_STEP 2
+#endif
+
+typedef struct {
+	uint64_t start_ms;             // first sample
+	uint8_t count;                 // samples, after averaging
+	int16_t mean[3];               // mg
+	uint32_t var[3];               // mg^2
+	uint16_t p2p[3];               // mg
+	uint16_t mag_mean;             // mg
+	uint32_t mag_var;              // mg^2
+	uint16_t mag_p2p;              // mg
+	uint8_t crossings;
+	uint16_t bins[FEATURE_BINS];   // amplitude, mg
+	uint8_t dominant;              // the strongest band
+} FeatureWindow;
+
+typedef void (*FeatureHandler)(const FeatureWindow *);
+
+void feature_init(FeatureHandler handler);
+void feature_reset(void);
+void feature_set_rate(uint8_t hz);
+uint8_t feature_window(void);
+void feature_add(const AccelData *data, uint32_t num_samples);
+uint32_t feature_isqrt(uint64_t n);
+
+#endif
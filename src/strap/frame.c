@@ -0,0 +1,209 @@
+/*
+Copyright 2014 EnSens, LLC D/B/A Strap
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <pebble.h>
+#include "frame.h"
+
+static void put16(uint8_t *p, uint16_t v) {
+	p[0] = v & 0xff;
+	p[1] = v >> 8;
+}
+
+static int varint_size(uint32_t v) {
+	int n = 1;
+	while (v >= 0x80) {
+		v >>= 7;
+		n++;
+	}
+	return n;
+}
+
+// writes v at the end of the frame unless it would pass limit
+static bool put_varint(Frame *f, uint32_t v, uint16_t limit) {
+	if (f->len + varint_size(v) > limit) {
+		return false;
+	}
+	while (v >= 0x80) {
+		f->buf[f->len++] = (v & 0x7f) | 0x80;
+		v >>= 7;
+	}
+	f->buf[f->len++] = v;
+	return true;
+}
+
+static uint32_t zigzag(int32_t v) {
+	return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static bool add_raw(Frame *f, const AccelData *data, uint32_t n) {
+	if (f->len + n * FRAME_RAW_SAMPLE_SIZE + (f->count + n + 7) / 8 > f->cap) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < n; i++) {
+		uint8_t *p = f->buf + f->len;
+		uint64_t dt = data[i].timestamp - f->last_ts;
+
+		put16(p, data[i].x);
+		put16(p + 2, data[i].y);
+		put16(p + 4, data[i].z);
+		put16(p + 6, dt > 0xffff ? 0xffff : dt);
+		f->len += FRAME_RAW_SAMPLE_SIZE;
+		f->last_ts = data[i].timestamp;
+
+		if (data[i].did_vibrate) {
+			f->vib[f->count / 8] |= 1 << (f->count % 8);
+		}
+		f->count++;
+	}
+	return true;
+}
+
+static bool add_delta(Frame *f, const AccelData *data, uint32_t n) {
+	// room for the run that frame_end may still have to close
+	uint16_t limit = f->cap - 2;
+
+	for (uint32_t i = 0; i < n; i++) {
+		const AccelData *s = &data[i];
+		uint64_t dt64 = s->timestamp - f->last_ts;
+		uint16_t dt = dt64 > 0xffff ? 0xffff : dt64;
+
+		if (s->x == f->x && s->y == f->y && s->z == f->z && dt == f->dt
+				&& !s->did_vibrate && f->count > 0) {
+			f->run++;
+		} else {
+			if (f->run && !put_varint(f, (uint32_t)f->run << 1, limit)) {
+				return false;
+			}
+			f->run = 0;
+
+			uint32_t tag = 1 | (s->did_vibrate ? 2 : 0) | (dt != f->dt ? 4 : 0);
+			if (!put_varint(f, tag, limit)
+					|| ((tag & 4) && !put_varint(f, dt, limit))
+					|| !put_varint(f, zigzag(s->x - f->x), limit)
+					|| !put_varint(f, zigzag(s->y - f->y), limit)
+					|| !put_varint(f, zigzag(s->z - f->z), limit)) {
+				return false;
+			}
+			f->x = s->x;
+			f->y = s->y;
+			f->z = s->z;
+			f->dt = dt;
+		}
+		f->last_ts = s->timestamp;
+		f->count++;
+	}
+	return true;
+}
+
+// hz is the rate every sample or window in the frame was taken at
+void frame_begin(Frame *f, uint8_t *buf, uint16_t cap, uint8_t enc, uint8_t hz) {
+	memset(f, 0, sizeof(*f));
+	f->buf = buf;
+	f->cap = cap;
+	f->enc = enc;
+	f->hz = hz;
+	f->len = FRAME_HEADER_SIZE;
+}
+
+// appends a whole batch or nothing, so a caller can stop at the first
+// batch that no longer fits
+bool frame_add(Frame *f, const AccelData *data, uint32_t n) {
+	if (n == 0) {
+		return true;
+	}
+	if (f->count + n > FRAME_MAX_SAMPLES) {
+		return false;
+	}
+
+	if (f->count == 0) {
+		f->last_ts = data[0].timestamp;
+		uint64_t base = data[0].timestamp;
+		for (int i = 0; i < 6; i++) {
+			f->buf[4 + i] = (base >> (8 * i)) & 0xff;
+		}
+	}
+
+	Frame saved = *f;
+	bool ok = f->enc == FRAME_ENC_DELTA ? add_delta(f, data, n)
+		: add_raw(f, data, n);
+	if (!ok) {
+		*f = saved;
+	}
+	return ok;
+}
+
+// appends a window's record, or nothing once the frame is full
+bool frame_add_window(Frame *f, const FeatureWindow *w) {
+	if (f->len + FRAME_FEATURE_SIZE > f->cap || f->count == FRAME_MAX_SAMPLES) {
+		return false;
+	}
+	if (f->count == 0) {
+		f->last_ts = w->start_ms;
+		for (int i = 0; i < 6; i++) {
+			f->buf[4 + i] = (w->start_ms >> (8 * i)) & 0xff;
+		}
+	}
+
+	uint8_t *p = f->buf + f->len;
+	uint64_t dt = w->start_ms - f->last_ts;
+	put16(p, dt > 0xffff ? 0xffff : dt);
+	p[2] = w->count;
+	p[3] = w->crossings;
+	for (int a = 0; a < 3; a++) {
+		put16(p + 4 + 2 * a, w->mean[a]);
+		put16(p + 10 + 2 * a, feature_isqrt(w->var[a]));
+		put16(p + 16 + 2 * a, w->p2p[a]);
+	}
+	put16(p + 22, w->mag_mean);
+	put16(p + 24, feature_isqrt(w->mag_var));
+	put16(p + 26, w->mag_p2p);
+	p[28] = w->dominant;
+	for (int i = 0; i < FEATURE_BINS; i++) {
+		uint16_t units = (w->bins[i] + FRAME_BIN_UNIT / 2) / FRAME_BIN_UNIT;
+		p[29 + i] = units < 0xff ? units : 0xff;
+	}
+
+	f->len += FRAME_FEATURE_SIZE;
+	f->last_ts = w->start_ms;
+	f->count++;
+	return true;
+}
+
+// writes the header and trailer, returns the frame length in bytes
+uint16_t frame_end(Frame *f) {
+	f->buf[0] = FRAME_VERSION;
+	f->buf[1] = f->enc;
+	f->buf[2] = f->count;
+	f->buf[3] = f->hz;
+	if (f->count == 0) {
+		memset(f->buf + 4, 0, 6);
+	}
+
+	if (f->enc == FRAME_ENC_FEATURES) {
+		return f->len;
+	}
+	if (f->enc == FRAME_ENC_DELTA) {
+		if (f->run) {
+			put_varint(f, (uint32_t)f->run << 1, f->cap);
+			f->run = 0;
+		}
+		return f->len;
+	}
+
+	memcpy(f->buf + f->len, f->vib, (f->count + 7) / 8);
+	return f->len + (f->count + 7) / 8;
+}
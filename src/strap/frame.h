@@ -0,0 +1,86 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+/*
+Packed accelerometer frame, sent as a single TUPLE_BYTE_ARRAY.
+
+  offset  size  field
+  0       1     version (FRAME_VERSION)
+  1       1     encoding (FRAME_ENC_*)
+  2       1     sample count
+  3       1     sampling rate, Hz; 0 from watches that did not send it
+  4       6     timestamp of the first sample, ms since epoch, little endian
+  10      ...   samples, in the layout given by the encoding
+
+FRAME_ENC_RAW, fixed size:
+
+  8*n   per sample: int16 x, y, z, uint16 ms since previous sample
+  n/8   did_vibrate mask, bit i of byte i/8 for sample i
+
+FRAME_ENC_DELTA, a stream of unsigned LEB128 varints. x, y, z and the
+sample interval start at 0 and are carried from sample to sample:
+
+  tag & 1 == 0  run: tag >> 1 samples repeat the previous x, y, z and
+                interval without vibration
+  tag & 1 == 1  literal: bit 1 is did_vibrate, bit 2 says a new interval
+                follows; then [interval], zigzag dx, dy, dz
+
+FRAME_ENC_FEATURES, fixed size, one record per feature window (see
+feature.h) with the sample count in the header counting windows:
+
+  2     ms since the previous window started, 0 for the first
+  1     samples in the window
+  1     magnitude crossings
+  6     int16 mean x, y, z, mg
+  6     uint16 standard deviation x, y, z, mg
+  6     uint16 peak-to-peak x, y, z, mg
+  6     uint16 magnitude mean, standard deviation, peak-to-peak, mg
+  1     dominant band
+  8     amplitude of each band, in FRAME_BIN_UNIT mg, at most 255
+
+All multi-byte fields are little endian. Decoded by strap_api_decodeFrame
+in pebble-js-app.js.
+*/
+
+#include "feature.h"
+
+#define FRAME_VERSION 1
+#define FRAME_ENC_RAW 0
+#define FRAME_ENC_DELTA 1
+#define FRAME_ENC_FEATURES 2
+
+#define FRAME_HEADER_SIZE 10
+#define FRAME_RAW_SAMPLE_SIZE 8
+#define FRAME_DELTA_SAMPLE_MAX 13  // tag, interval and three 3-byte deltas
+#define FRAME_MAX_SAMPLES 255
+#define FRAME_FEATURE_SIZE (29 + FEATURE_BINS)
+#define FRAME_BIN_UNIT 4
+
+// bytes needed for a raw frame of n samples
+#define FRAME_RAW_SIZE(n) \
+	(FRAME_HEADER_SIZE + (n) * FRAME_RAW_SAMPLE_SIZE + ((n) + 7) / 8)
+
+// worst case for a delta frame of n samples, including the closing run
+#define FRAME_DELTA_SIZE(n) \
+	(FRAME_HEADER_SIZE + (n) * FRAME_DELTA_SAMPLE_MAX + 2)
+
+typedef struct {
+	uint8_t *buf;
+	uint16_t cap;
+	uint16_t len;
+	uint8_t count;
+	uint8_t enc;
+	uint8_t hz;
+	uint64_t last_ts;
+	int16_t x, y, z;    // previous sample, for delta coding
+	uint16_t dt;        // previous interval
+	uint16_t run;       // repeats not yet written
+	uint8_t vib[(FRAME_MAX_SAMPLES + 7) / 8];
+} Frame;
+
+void frame_begin(Frame *, uint8_t *, uint16_t, uint8_t, uint8_t);
+bool frame_add(Frame *, const AccelData *, uint32_t);
+bool frame_add_window(Frame *, const FeatureWindow *);
+uint16_t frame_end(Frame *);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef MESSAGE_H
+#define MESSAGE_H
+
+/*
+Sizes of the AppMessage dictionaries strap sends and receives, worked out
+from their layouts at compile time the way dict_calc_buffer_size does at
+run time: a byte of header, then for each tuple its key, type and length
+and its value. The app opens its buffers with STRAP_INBOX_SIZE and
+STRAP_OUTBOX_SIZE instead of the maximum, which the firmware takes from
+the app heap.
+*/
+
+#include "config.h"
+
+#define DICT_HEADER_SIZE 1
+#define DICT_TUPLE_OVERHEAD 7
+#define DICT_SIZE(tuples, bytes) \
+	(DICT_HEADER_SIZE + (tuples) * DICT_TUPLE_OVERHEAD + (bytes))
+
+#define MSG_ACTIVITY_MAX 15   // T_ACTIVITY, with its NUL
+#define MSG_FRAME_MAX 600     // T_FRAME, see frame.h
+#define MSG_LOG_PATH_MAX 50   // T_LOG, with its NUL
+
+// accel: activity and frame
+#define MSG_ACCL_SIZE DICT_SIZE(2, MSG_ACTIVITY_MAX + MSG_FRAME_MAX)
+// log: a path (or the smaller code), count and time
+#define MSG_LOG_SIZE DICT_SIZE(3, MSG_LOG_PATH_MAX + 4 + 4)
+// config: every setting at once, as the int32 PebbleKit JS sends
+#define MSG_CONFIG_SIZE DICT_SIZE(CONFIG_KEYS, CONFIG_KEYS * 4)
+
+#define MSG_MAX(a, b) ((a) > (b) ? (a) : (b))
+
+#define STRAP_OUTBOX_SIZE MSG_MAX(MSG_ACCL_SIZE, MSG_LOG_SIZE)
+#define STRAP_INBOX_SIZE MSG_CONFIG_SIZE
+
+#endif
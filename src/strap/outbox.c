@@ -0,0 +1,199 @@
+/*
+Copyright 2014 EnSens, LLC D/B/A Strap
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <pebble.h>
+#include "outbox.h"
+#include "stats.h"
+
+#define NONE 0xff
+
+static const OutboxSource *sources[OUTBOX_SRC_COUNT];
+
+// when each source was first seen ready, 0 while it is not
+static uint64_t ready_since[OUTBOX_SRC_COUNT];
+
+static uint8_t in_flight = NONE;
+static uint64_t in_flight_since = 0;  // when it was first ready, for stats
+static AppTimer *retry_timer = NULL;
+static uint32_t retry_ms = OUTBOX_RETRY_MS;
+static OutboxStats stats;
+
+static uint64_t now_ms(void) {
+	time_t now;
+	uint16_t ms;
+	time_ms(&now, &ms);
+	return (uint64_t)now * 1000 + ms;
+}
+
+static void retry_callback(void *data) {
+	STATS(stats_wakeup(STATS_WAKE_TIMER));
+	retry_timer = NULL;
+	outbox_kick();
+}
+
+// the only timer here; each retry in a row waits twice as long
+static void schedule_retry(void) {
+	if (!retry_timer) {
+		retry_timer = app_timer_register(retry_ms, retry_callback, NULL);
+		retry_ms = retry_ms < OUTBOX_RETRY_MAX_MS / 2 ? retry_ms * 2 : OUTBOX_RETRY_MAX_MS;
+	}
+}
+
+void outbox_init(void) {
+	memset(sources, 0, sizeof(sources));
+	memset(ready_since, 0, sizeof(ready_since));
+	memset(&stats, 0, sizeof(stats));
+	in_flight = NONE;
+	retry_ms = OUTBOX_RETRY_MS;
+	app_message_register_outbox_sent(outbox_sent_handler);
+	app_message_register_outbox_failed(outbox_failed_handler);
+}
+
+void outbox_deinit(void) {
+	if (retry_timer) {
+		app_timer_cancel(retry_timer);
+		retry_timer = NULL;
+	}
+}
+
+void outbox_register(OutboxSourceId id, const OutboxSource *source) {
+	sources[id] = source;
+}
+
+bool outbox_in_flight(void) {
+	return in_flight != NONE;
+}
+
+const OutboxStats *outbox_get_stats(void) {
+	return &stats;
+}
+
+// the most overdue ready source, else the ready one with the best priority
+static uint8_t pick_source(void) {
+	uint64_t now = now_ms();
+	uint8_t best = NONE;
+	int64_t best_overdue = -1;
+	for (uint8_t i = 0; i < OUTBOX_SRC_COUNT; i++) {
+		const OutboxSource *src = sources[i];
+		if (!src || !src->ready()) {
+			ready_since[i] = 0;
+			continue;
+		}
+		if (!ready_since[i]) {
+			ready_since[i] = now;
+		}
+		int64_t overdue = (int64_t)(now - ready_since[i]) - src->deadline_ms;
+		if (best == NONE
+				|| (overdue >= 0 && overdue > best_overdue)
+				|| (best_overdue < 0 && overdue < 0
+					&& src->priority < sources[best]->priority)) {
+			best = i;
+			best_overdue = overdue;
+		}
+	}
+	return best;
+}
+
+void outbox_kick(void) {
+	// nothing reaches the phone while it is away; sources keep their data.
+	// After a failure only the retry timer sends again, so new data from
+	// the sources does not undo the backoff.
+	if (in_flight != NONE || retry_timer || !bluetooth_connection_service_peek()) {
+		return;
+	}
+
+	uint8_t id = pick_source();
+	if (id == NONE) {
+		return;
+	}
+
+	DictionaryIterator *iter;
+	if (app_message_outbox_begin(&iter) != APP_MSG_OK) {
+		stats.busy++;
+		schedule_retry();
+		return;
+	}
+
+	const OutboxSource *src = sources[id];
+	if (src->depth) {
+		uint16_t depth = src->depth();
+		stats.depth[id] = depth;
+		if (depth > stats.depth_max[id]) {
+			stats.depth_max[id] = depth;
+		}
+	}
+	src->write(iter);
+	uint32_t bytes = dict_write_end(iter);
+	// a refused send gets neither callback, so it is failed here
+	AppMessageResult result = app_message_outbox_send();
+	if (result != APP_MSG_OK) {
+		STATS(stats_failed(id, result));
+		stats.failed[id]++;
+		APP_LOG(APP_LOG_LEVEL_DEBUG, "outbox: source %d refused, error 0x%02X", id, result);
+		if (src->failed) {
+			src->failed(result);
+		}
+		schedule_retry();
+		return;
+	}
+	STATS(stats_sent(id, bytes));
+	(void)bytes;
+	in_flight = id;
+	in_flight_since = ready_since[id];
+	ready_since[id] = 0;
+}
+
+void outbox_sent_handler(DictionaryIterator *iter, void *context) {
+	STATS(stats_wakeup(STATS_WAKE_OUTBOX));
+	STATS(uint64_t started = stats_clock());
+	uint8_t id = in_flight;
+	if (id == NONE) {
+		return;
+	}
+	STATS(stats_acked(id, now_ms() - in_flight_since));
+	in_flight = NONE;
+	retry_ms = OUTBOX_RETRY_MS;
+	if (retry_timer) {
+		app_timer_cancel(retry_timer);
+		retry_timer = NULL;
+	}
+	stats.sent[id]++;
+	if (stats.sent[id] % 100 == 0) {
+		APP_LOG(APP_LOG_LEVEL_INFO, "outbox: source %d sent %d failed %d depth %d max %d busy %d",
+			id, stats.sent[id], stats.failed[id], stats.depth[id], stats.depth_max[id], stats.busy);
+	}
+	if (sources[id]->sent) {
+		sources[id]->sent();
+	}
+	outbox_kick();
+	STATS(stats_handler(STATS_H_OUTBOX, started));
+}
+
+void outbox_failed_handler(DictionaryIterator *iter, AppMessageResult reason, void *context) {
+	STATS(stats_wakeup(STATS_WAKE_OUTBOX));
+	uint8_t id = in_flight;
+	if (id == NONE) {
+		return;
+	}
+	STATS(stats_failed(id, reason));
+	in_flight = NONE;
+	stats.failed[id]++;
+	APP_LOG(APP_LOG_LEVEL_DEBUG, "outbox: source %d failed to send, error 0x%02X", id, reason);
+	if (sources[id]->failed) {
+		sources[id]->failed(reason);
+	}
+	schedule_retry();
+}
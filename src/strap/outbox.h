@@ -0,0 +1,66 @@
+#ifndef OUTBOX_H
+#define OUTBOX_H
+
+/*
+One transmit scheduler for everything strap sends to the phone. It owns
+the AppMessage outbox callbacks and keeps a single message in flight.
+
+Each kind of traffic registers a source. When the outbox is free the
+scheduler asks every source whether it is ready and lets one of them
+write the next message:
+
+  - a source that has been ready for longer than its deadline goes
+    first, the most overdue one ahead of the rest;
+  - otherwise the ready source with the lowest priority value goes.
+
+Sources call outbox_kick() when they have something new, and every ack
+kicks the next message, so nothing polls. A failed or refused send is
+retried after OUTBOX_RETRY_MS, doubling for each retry in a row up to
+OUTBOX_RETRY_MAX_MS. Kicks wait while a retry is pending; the next ack
+ends the backoff.
+*/
+
+typedef enum {
+	OUTBOX_SRC_ACCL,
+	OUTBOX_SRC_LOG,
+	OUTBOX_SRC_BATTERY,
+	OUTBOX_SRC_COUNT
+} OutboxSourceId;
+
+typedef struct {
+	uint8_t priority;       // lower goes first
+	uint16_t deadline_ms;   // ready this long, it goes ahead of priority
+	bool (*ready)(void);
+	uint16_t (*depth)(void);                 // items queued, for stats
+	void (*write)(DictionaryIterator *iter); // fills the message
+	void (*sent)(void);
+	void (*failed)(AppMessageResult reason);
+} OutboxSource;
+
+typedef struct {
+	uint16_t sent[OUTBOX_SRC_COUNT];
+	uint16_t failed[OUTBOX_SRC_COUNT];
+	uint16_t depth[OUTBOX_SRC_COUNT];      // at the last send
+	uint16_t depth_max[OUTBOX_SRC_COUNT];
+	uint16_t busy;                         // outbox_begin refused
+} OutboxStats;
+
+#ifndef OUTBOX_RETRY_MS
+#define OUTBOX_RETRY_MS 1000
+#endif
+
+#ifndef OUTBOX_RETRY_MAX_MS
+#define OUTBOX_RETRY_MAX_MS (30 * 1000)
+#endif
+
+void outbox_init(void);
+void outbox_deinit(void);
+void outbox_register(OutboxSourceId id, const OutboxSource *source);
+void outbox_kick(void);
+bool outbox_in_flight(void);
+const OutboxStats *outbox_get_stats(void);
+
+void outbox_sent_handler(DictionaryIterator *iter, void *context);
+void outbox_failed_handler(DictionaryIterator *iter, AppMessageResult reason, void *context);
+
+#endif
@@ -0,0 +1,293 @@
+/*
+Copyright 2014 EnSens, LLC D/B/A Strap
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <pebble.h>
+#include "spool.h"
+#include "stats.h"
+
+#define SPOOL_PATH_MAX 63
+#define SPOOL_FOLD_SECONDS 60  // repeats this close together share a record
+
+typedef struct {
+	uint8_t head;      // oldest chunk
+	uint8_t len;       // chunks in use, the newest one still open
+	uint16_t dropped;  // records refused because every chunk was full
+} SpoolMeta;
+
+static SpoolMeta meta;
+static bool meta_dirty = false;
+
+// the open chunk, newest record last at wlast
+static uint8_t wbuf[SPOOL_CHUNK_BYTES];
+static uint16_t wfill = 0;
+static int16_t wlast = -1;
+static bool wdirty = false;
+
+// the chunk being drained, already removed from storage
+static uint8_t rbuf[SPOOL_CHUNK_BYTES];
+static uint16_t rfill = 0;
+static uint16_t rpos = 0;
+
+static AppTimer *flush_timer = NULL;
+
+static uint32_t chunk_key(uint8_t i) {
+	return SPOOL_KEY_META + 1 + (i % SPOOL_CHUNKS);
+}
+
+static uint16_t get16(const uint8_t *p) {
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put16(uint8_t *p, uint16_t v) {
+	p[0] = v & 0xff;
+	p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+	put16(p, v & 0xffff);
+	put16(p + 2, v >> 16);
+}
+
+// the record at r, checked by record_at, with path as room for its path
+static void read_record(const uint8_t *r, StrapEvent *event, char *path) {
+	if (r[0] == SPOOL_CODED) {
+		event->id = r[SPOOL_RECORD_HEADER];
+		event->arg = get16(r + SPOOL_RECORD_HEADER + 1);
+		event->path = NULL;
+		return;
+	}
+	memcpy(path, r + SPOOL_RECORD_HEADER, r[0]);
+	path[r[0]] = '\0';
+	event->id = STRAP_EV_PATH;
+	event->arg = 0;
+	event->path = path;
+}
+
+static uint16_t record_size(const uint8_t *r) {
+	return SPOOL_RECORD_HEADER + (r[0] == SPOOL_CODED ? 3 : r[0]);
+}
+
+// the size of the record at rbuf + pos, or 0 when the rest of rbuf is torn
+static uint16_t record_at(uint16_t pos) {
+	const uint8_t *r = rbuf + pos;
+	if ((r[0] > SPOOL_PATH_MAX && r[0] != SPOOL_CODED)
+			|| pos + record_size(r) > rfill) {
+		return 0;
+	}
+	return record_size(r);
+}
+
+static void flush_timer_callback(void *data) {
+	STATS(stats_wakeup(STATS_WAKE_TIMER));
+	flush_timer = NULL;
+	spool_flush();
+}
+
+// unsaved records reach storage within SPOOL_FLUSH_MS
+static void schedule_flush(void) {
+	if (!flush_timer) {
+		flush_timer = app_timer_register(SPOOL_FLUSH_MS, flush_timer_callback, NULL);
+	}
+}
+
+void spool_init(void) {
+	memset(&meta, 0, sizeof(meta));
+	if (persist_exists(SPOOL_KEY_META)) {
+		persist_read_data(SPOOL_KEY_META, &meta, sizeof(meta));
+	}
+	if (meta.len > SPOOL_CHUNKS || meta.head >= SPOOL_CHUNKS) {
+		memset(&meta, 0, sizeof(meta));
+		meta_dirty = true;
+	}
+
+	// reopen the newest chunk so new records keep filling it
+	wfill = 0;
+	wlast = -1;
+	if (meta.len > 0) {
+		uint32_t key = chunk_key(meta.head + meta.len - 1);
+		if (persist_exists(key)) {
+			int size = persist_read_data(key, wbuf, sizeof(wbuf));
+			wfill = size > 0 ? size : 0;
+		}
+	}
+	rfill = rpos = 0;
+}
+
+// puts records taken out of storage back as the oldest chunk, ahead of
+// anything spooled since
+static void unload_chunk(const uint8_t *data, uint16_t n, uint16_t records) {
+	if (n == 0) {
+		return;
+	}
+	if (meta.len == SPOOL_CHUNKS) {
+		meta.dropped += records;
+	} else if (meta.len == 0) {
+		// it is the only chunk, so it is also the open one
+		memcpy(wbuf, data, n);
+		wfill = n;
+		wlast = -1;
+		wdirty = true;
+		meta.len++;
+	} else {
+		meta.head = (meta.head + SPOOL_CHUNKS - 1) % SPOOL_CHUNKS;
+		persist_write_data(chunk_key(meta.head), data, n);
+		meta.len++;
+	}
+	meta_dirty = true;
+}
+
+// records handed out of storage but not yet taken go back at the head
+void spool_deinit(void) {
+	uint16_t end = rpos, records = 0, size;
+	while (end < rfill && (size = record_at(end)) > 0) {
+		end += size;
+		records++;
+	}
+	unload_chunk(rbuf + rpos, end - rpos, records);
+	rfill = rpos = 0;
+	spool_flush();
+	if (flush_timer) {
+		app_timer_cancel(flush_timer);
+		flush_timer = NULL;
+	}
+}
+
+void spool_flush(void) {
+	if (wdirty && meta.len > 0) {
+		persist_write_data(chunk_key(meta.head + meta.len - 1), wbuf, wfill);
+		wdirty = false;
+	}
+	if (meta_dirty) {
+		persist_write_data(SPOOL_KEY_META, &meta, sizeof(meta));
+		meta_dirty = false;
+	}
+}
+
+bool spool_empty(void) {
+	return meta.len == 0 && rpos >= rfill;
+}
+
+bool spool_append(const StrapEvent *event, uint16_t count, uint32_t time) {
+	// the record's first byte and what follows the header
+	uint8_t body[3];
+	const uint8_t *data = body;
+	size_t n = 3;
+	uint8_t tag = SPOOL_CODED;
+	if (event->id == STRAP_EV_PATH) {
+		data = (const uint8_t *)event->path;
+		n = strlen(event->path);
+		if (n > SPOOL_PATH_MAX) {
+			n = SPOOL_PATH_MAX;
+		}
+		tag = n;
+	} else {
+		body[0] = event->id;
+		put16(body + 1, event->arg);
+	}
+
+	// a repeat of the newest record only bumps its count
+	if (wlast >= 0) {
+		uint8_t *r = wbuf + wlast;
+		uint32_t total = get16(r + 1) + count;
+		if (r[0] == tag && !memcmp(r + SPOOL_RECORD_HEADER, data, n)
+				&& time - get32(r + 3) < SPOOL_FOLD_SECONDS
+				&& total <= UINT16_MAX) {
+			put16(r + 1, total);
+			wdirty = true;
+			schedule_flush();
+			return true;
+		}
+	}
+
+	// records do not span chunks; close the open one when this won't fit
+	if (meta.len == 0 || wfill + SPOOL_RECORD_HEADER + n > SPOOL_CHUNK_BYTES) {
+		if (meta.len == SPOOL_CHUNKS) {
+			meta.dropped++;
+			meta_dirty = true;
+			return false;
+		}
+		spool_flush();
+		meta.len++;
+		meta_dirty = true;
+		wfill = 0;
+	}
+
+	uint8_t *r = wbuf + wfill;
+	r[0] = tag;
+	put16(r + 1, count);
+	put32(r + 3, time);
+	memcpy(r + SPOOL_RECORD_HEADER, data, n);
+	wlast = wfill;
+	wfill += SPOOL_RECORD_HEADER + n;
+	wdirty = true;
+	schedule_flush();
+	return true;
+}
+
+// takes the oldest chunk out of storage into rbuf
+static bool load_chunk(void) {
+	if (meta.len == 0) {
+		return false;
+	}
+	uint32_t key = chunk_key(meta.head);
+	if (meta.len == 1) {
+		// the open chunk is already in RAM
+		memcpy(rbuf, wbuf, wfill);
+		rfill = wfill;
+		wfill = 0;
+		wlast = -1;
+		wdirty = false;
+	} else {
+		int size = persist_read_data(key, rbuf, sizeof(rbuf));
+		rfill = size > 0 ? size : 0;
+		meta.head = (meta.head + 1) % SPOOL_CHUNKS;
+	}
+	rpos = 0;
+	meta.len--;
+	meta_dirty = true;
+	persist_delete(key);
+	spool_flush();
+	return true;
+}
+
+// hands records to the handler, oldest first, until it is full
+void spool_drain(SpoolHandler handler) {
+	for (;;) {
+		if (rpos >= rfill && !load_chunk()) {
+			return;
+		}
+		while (rpos < rfill) {
+			const uint8_t *r = rbuf + rpos;
+			uint16_t size = record_at(rpos);
+			if (!size) {
+				// a torn chunk; skip what is left of it
+				rpos = rfill;
+				break;
+			}
+			StrapEvent event;
+			char path[SPOOL_PATH_MAX + 1];
+			read_record(r, &event, path);
+			if (!handler(&event, get16(r + 1), get32(r + 3))) {
+				return;
+			}
+			rpos += size;
+		}
+	}
+}
@@ -0,0 +1,51 @@
+#ifndef SPOOL_H
+#define SPOOL_H
+
+/*
+Strap events logged while the phone is out of reach, kept in persistent
+storage until the connection comes back.
+
+Records are packed back to back into chunks of up to SPOOL_CHUNK_BYTES,
+each stored under its own key. The chunks form a ring; a meta key holds
+the index of the oldest chunk and how many are in use. The newest chunk
+is built in RAM and written out when it fills, SPOOL_FLUSH_MS after its
+first unsaved record, or on spool_flush(), so a burst of events costs one
+flash write rather than one per event.
+
+  offset  size  field
+  0       1     path length n, or SPOOL_CODED for an event in events.def
+  1       2     count, times the event repeated
+  3       4     time of the first occurrence, seconds
+  7       n     path, not terminated
+  7       3     or for SPOOL_CODED, the event code and its number
+
+All multi-byte fields are little endian.
+*/
+
+#include "events.h"
+
+#define SPOOL_KEY_META (48000 + 5000)  // chunk i is at SPOOL_KEY_META + 1 + i
+#define SPOOL_CHUNK_BYTES 256          // PERSIST_DATA_MAX_LENGTH
+#define SPOOL_RECORD_HEADER 7
+#define SPOOL_CODED 0x80               // above any path length
+
+// room given to the spool out of the app's 4 KB of persistent storage
+#ifndef SPOOL_CHUNKS
+#define SPOOL_CHUNKS 6
+#endif
+
+#ifndef SPOOL_FLUSH_MS
+#define SPOOL_FLUSH_MS (60 * 1000)
+#endif
+
+// takes one drained record; returns false when it has no room for it
+typedef bool (*SpoolHandler)(const StrapEvent *event, uint16_t count, uint32_t time);
+
+void spool_init(void);
+void spool_deinit(void);
+bool spool_append(const StrapEvent *event, uint16_t count, uint32_t time);
+void spool_flush(void);
+bool spool_empty(void);
+void spool_drain(SpoolHandler handler);
+
+#endif
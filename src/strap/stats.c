@@ -0,0 +1,203 @@
+/*
+Copyright 2014 EnSens, LLC D/B/A Strap
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <pebble.h>
+#include "stats.h"
+
+#ifdef STRAP_STATS
+
+#define LINE_COLS 50  // a report line is sent as one log event
+
+static struct {
+	uint16_t sent[STATS_SOURCES];
+	uint32_t bytes[STATS_SOURCES];
+	uint16_t acked;
+	uint16_t latency[STATS_LATENCY_BUCKETS];
+	uint16_t failed[STATS_RESULTS];
+	uint32_t wakeups[STATS_WAKE_COUNT];
+	uint32_t calls[STATS_H_COUNT];
+	uint32_t handler_ms[STATS_H_COUNT];
+	uint16_t handler_max_ms[STATS_H_COUNT];
+	uint32_t sniff_ms;
+	uint64_t sniff_since;   // 0 unless the sniff interval is reduced
+	uint64_t started;
+} counters;
+
+static Window *window = NULL;
+static TextLayer *text = NULL;
+static char report[10 * LINE_COLS];
+
+static uint8_t taps = 0;
+static uint64_t first_tap = 0;
+
+uint64_t stats_clock(void) {
+	time_t now;
+	uint16_t ms;
+	time_ms(&now, &ms);
+	return (uint64_t)now * 1000 + ms;
+}
+
+void stats_sent(uint8_t source, uint16_t bytes) {
+	counters.sent[source]++;
+	counters.bytes[source] += bytes;
+}
+
+void stats_acked(uint8_t source, uint32_t latency_ms) {
+	counters.acked++;
+	uint8_t bucket = 0;
+	for (uint32_t limit = 64; latency_ms >= limit
+			&& bucket < STATS_LATENCY_BUCKETS - 1; limit <<= 1) {
+		bucket++;
+	}
+	counters.latency[bucket]++;
+}
+
+void stats_failed(uint8_t source, AppMessageResult reason) {
+	uint8_t bit = 0;
+	while (bit < STATS_RESULTS - 1 && !(reason & (1 << bit))) {
+		bit++;
+	}
+	counters.failed[bit]++;
+}
+
+void stats_wakeup(StatsWake cause) {
+	counters.wakeups[cause]++;
+}
+
+void stats_sniff(bool reduced) {
+	uint64_t now = stats_clock();
+	if (reduced && !counters.sniff_since) {
+		counters.sniff_since = now;
+	} else if (!reduced && counters.sniff_since) {
+		counters.sniff_ms += now - counters.sniff_since;
+		counters.sniff_since = 0;
+	}
+}
+
+void stats_handler(StatsHandler handler, uint64_t started) {
+	uint32_t ms = stats_clock() - started;
+	counters.calls[handler]++;
+	counters.handler_ms[handler] += ms;
+	if (ms > counters.handler_max_ms[handler]) {
+		counters.handler_max_ms[handler] = ms;
+	}
+}
+
+// formats the report one line at a time, each fit for a log event
+void stats_report(void (*line)(char *)) {
+	char buf[LINE_COLS];
+	uint64_t now = stats_clock();
+	uint32_t sniff_ms = counters.sniff_ms
+		+ (counters.sniff_since ? now - counters.sniff_since : 0);
+	uint32_t up_s = (now - counters.started) / 1000;
+
+	snprintf(buf, sizeof(buf), "STRAP_API_STATS/up=%lus,sniff=%lus",
+		(unsigned long)up_s, (unsigned long)(sniff_ms / 1000));
+	line(buf);
+	snprintf(buf, sizeof(buf), "STRAP_API_STATS/tx=%u,%u,%u,ack=%u",
+		counters.sent[0], counters.sent[1], counters.sent[2], counters.acked);
+	line(buf);
+	snprintf(buf, sizeof(buf), "STRAP_API_STATS/kb=%lu,%lu,%lu",
+		(unsigned long)(counters.bytes[0] / 1024),
+		(unsigned long)(counters.bytes[1] / 1024),
+		(unsigned long)(counters.bytes[2] / 1024));
+	line(buf);
+
+	// latency buckets in order, then failures as bit:count
+	int n = snprintf(buf, sizeof(buf), "STRAP_API_STATS/lat=");
+	for (int i = 0; i < STATS_LATENCY_BUCKETS && n < (int)sizeof(buf); i++) {
+		n += snprintf(buf + n, sizeof(buf) - n, i ? ",%u" : "%u", counters.latency[i]);
+	}
+	line(buf);
+	n = snprintf(buf, sizeof(buf), "STRAP_API_STATS/fail=");
+	for (int i = 0; i < STATS_RESULTS && n < (int)sizeof(buf); i++) {
+		if (counters.failed[i]) {
+			n += snprintf(buf + n, sizeof(buf) - n, "%d:%u,", i, counters.failed[i]);
+		}
+	}
+	line(buf);
+
+	snprintf(buf, sizeof(buf), "STRAP_API_STATS/wake=%lu,%lu",
+		(unsigned long)counters.wakeups[STATS_WAKE_ACCEL],
+		(unsigned long)counters.wakeups[STATS_WAKE_OUTBOX]);
+	line(buf);
+	snprintf(buf, sizeof(buf), "STRAP_API_STATS/timers=%lu",
+		(unsigned long)counters.wakeups[STATS_WAKE_TIMER]);
+	line(buf);
+
+	// calls, total ms and longest ms of each handler
+	for (int i = 0; i < STATS_H_COUNT; i++) {
+		snprintf(buf, sizeof(buf), "STRAP_API_STATS/cpu%d=%lu,%lu,%u", i,
+			(unsigned long)counters.calls[i], (unsigned long)counters.handler_ms[i],
+			counters.handler_max_ms[i]);
+		line(buf);
+	}
+}
+
+// the debug window shows the report lines without their common prefix
+static void append_line(char *line) {
+	const char *value = line + strlen("STRAP_API_STATS/");
+	size_t used = strlen(report);
+	snprintf(report + used, sizeof(report) - used, "%s\n", value);
+}
+
+static void window_load(Window *w) {
+	Layer *root = window_get_root_layer(w);
+	text = text_layer_create(layer_get_bounds(root));
+	text_layer_set_font(text, fonts_get_system_font(FONT_KEY_GOTHIC_14));
+	report[0] = '\0';
+	stats_report(append_line);
+	text_layer_set_text(text, report);
+	layer_add_child(root, text_layer_get_layer(text));
+}
+
+static void window_unload(Window *w) {
+	text_layer_destroy(text);
+	text = NULL;
+}
+
+// strap passes on every tap; three in a row open the window
+void stats_tap(void) {
+	uint64_t now = stats_clock();
+	if (taps == 0 || now - first_tap > STATS_TAP_MS) {
+		taps = 0;
+		first_tap = now;
+	}
+	if (++taps < 3) {
+		return;
+	}
+	taps = 0;
+	if (!window_stack_contains_window(window)) {
+		window_stack_push(window, true);
+	}
+}
+
+void stats_init(void) {
+	memset(&counters, 0, sizeof(counters));
+	counters.started = stats_clock();
+	window = window_create();
+	window_set_window_handlers(window, (WindowHandlers) {
+		.load = window_load,
+		.unload = window_unload,
+	});
+}
+
+void stats_deinit(void) {
+	window_destroy(window);
+	window = NULL;
+}
+
+#endif
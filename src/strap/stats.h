@@ -0,0 +1,67 @@
+#ifndef STATS_H
+#define STATS_H
+
+/*
+Counters for what the strap subsystem costs in radio and CPU time, built
+only with STRAP_STATS defined (see strap.h). Without it every STATS(...)
+call site compiles to nothing.
+
+  - messages and bytes sent per outbox source
+  - send latency, from the source having a message ready to its ack, in
+    a power of two histogram from under 64 ms to 32 s and over
+  - failures by AppMessageResult
+  - wakeups by cause: accel batch, outbox callback, timer
+  - time spent with the radio in the reduced sniff interval
+  - calls and time spent in each handler
+
+Handler time comes from time_ms(), so it has millisecond resolution;
+the watch has no cycle counter that apps can read.
+
+Three taps within STATS_TAP_MS open a debug window with the report, and
+stats_report() sends it as STRAP_API_STATS/... log events.
+*/
+
+#include "strap.h"
+
+#ifdef STRAP_STATS
+
+#define STATS(call) call
+
+#define STATS_SOURCES 3
+#define STATS_LATENCY_BUCKETS 11  // < 64 ms, < 128 ms ... < 32 s, more
+#define STATS_RESULTS 15          // one per AppMessageResult bit
+#define STATS_TAP_MS 1500
+
+typedef enum {
+	STATS_WAKE_ACCEL,
+	STATS_WAKE_OUTBOX,
+	STATS_WAKE_TIMER,
+	STATS_WAKE_COUNT
+} StatsWake;
+
+typedef enum {
+	STATS_H_ACCEL,
+	STATS_H_OUTBOX,
+	STATS_H_LOG,
+	STATS_H_COUNT
+} StatsHandler;
+
+void stats_init(void);
+void stats_deinit(void);
+void stats_sent(uint8_t source, uint16_t bytes);
+void stats_acked(uint8_t source, uint32_t latency_ms);
+void stats_failed(uint8_t source, AppMessageResult reason);
+void stats_wakeup(StatsWake cause);
+void stats_sniff(bool reduced);
+void stats_tap(void);
+uint64_t stats_clock(void);
+void stats_handler(StatsHandler handler, uint64_t started);
+void stats_report(void (*line)(char *));
+
+#else
+
+#define STATS(call)
+
+#endif
+
+#endif
@@ -17,6 +17,11 @@ limitations under the License.
 #include <pebble.h>
 #include "strap.h"
 #include "accl.h"
+#include "spool.h"
+#include "outbox.h"
+#include "duty.h"
+#include "config.h"
+#include "stats.h"
 
 #define TupletStaticCString(_key, _cstring, _length) \
 ((const Tuplet) { .type = TUPLE_CSTRING, .key = _key, .cstring = { .data = _cstring, .length = _length + 1 }})
@@ -30,32 +35,79 @@ limitations under the License.
 #define T_DID_VIBRATE 5 // string T/F
 #define T_ACTIVITY 2000
 #define T_LOG 3000
+#define T_LOG_COUNT 3001 // int, times the event repeated
+#define T_LOG_TIME 3002  // int, seconds; set on events that waited offline
+#define T_LOG_EVENT 3003 // int, an events.def code in the low byte, its number above
 
 #define NUM_SAMPLES 10
-static int report_accl = 0;
-static char cur_activity[15];
 
 
-#define LOG_ROWS 30
-#define LOG_COLS 50
-static char logqueue[LOG_ROWS][LOG_COLS];
-static int curLog = 0;
+#define LOG_ROWS 60
+#define LOG_COLS MSG_LOG_PATH_MAX
+
+// paths of queued events that are not in events.def; the stats report
+// sends ten at once
+#ifdef STRAP_STATS
+#define LOG_PATHS 12
+#else
+#define LOG_PATHS 8
+#endif
+
+// the firmware always has room for the minimum, whatever else is running
+_Static_assert(STRAP_OUTBOX_SIZE <= APP_MESSAGE_OUTBOX_SIZE_MINIMUM,
+	"strap messages must fit the smallest outbox");
+_Static_assert(STRAP_INBOX_SIZE <= APP_MESSAGE_INBOX_SIZE_MINIMUM,
+	"a config message must fit the smallest inbox");
+
+// an event waiting for the outbox; back to back repeats of the same event
+// are folded into one record and sent once with their count. time is 0
+// for live events and the original time for ones drained from the spool.
+typedef struct {
+	uint32_t time;
+	uint16_t count;
+	uint16_t arg;
+	uint8_t id;       // STRAP_EV_PATH takes the next path from logpaths
+} LogRecord;
+
+// circular queue, oldest record at logHead
+static LogRecord logqueue[LOG_ROWS];
+static uint8_t logHead = 0;
+static uint8_t logLen = 0;
+static bool logInflight = false;  // the head record is in the outbox
+static uint16_t logDropped = 0;
+
+// circular queue of paths, in the order of their records
+static char logpaths[LOG_PATHS][LOG_COLS];
+static uint8_t pathHead = 0;
+static uint8_t pathLen = 0;
+
+static const char* const eventPaths[] = {
+#define STRAP_EVENT(name, path, has_arg) path,
+#include "events.def"
+#undef STRAP_EVENT
+};
+
+// only the latest battery reading is worth sending
+static bool battPending = false;
+static uint8_t battPercent = 0;
 static int curFreq = 1;  // frequency multiplier
 
-static AppTimer* acclStop = NULL;
-static AppTimer* acclStart = NULL;
+static AccelTapHandler tapHandler = NULL;
+
 static AppTimer* acclRetry = NULL;
 static AppTimer* battTimer = NULL;
 
 static void send_accl_data(void*);
 static void send_accl_data_core(void*);
-static void app_timer_accl_stop(void*);
-static void app_timer_accl_start(void*);
 static void accl_new_data(AccelData*, uint32_t);
 static void log_action(void*);
+static void log_event(const StrapEvent*);
+static void log_start(void*);
 static void app_timer_battery(void*);
-static void appendLog(char*);
-static void send_next_log(void*);
+static bool appendLog(const StrapEvent*, uint16_t, uint32_t);
+static void write_log(DictionaryIterator*, const StrapEvent*, uint16_t, uint32_t);
+static void spool_logs();
+static void strap_bt_handler(bool);
 static bool is_accl_available();
 static bool is_log_available();
 
@@ -64,235 +116,406 @@ static char* translate_error(AppMessageResult);
 
 static char* translate_error(AppMessageResult result) {
   switch (result) {
-    case APP_MSG_OK: return "APP_MSG_OK";
-    case APP_MSG_SEND_TIMEOUT: return "APP_MSG_SEND_TIMEOUT";
-    case APP_MSG_SEND_REJECTED: return "APP_MSG_SEND_REJECTED";
-    case APP_MSG_NOT_CONNECTED: return "APP_MSG_NOT_CONNECTED";
-    case APP_MSG_APP_NOT_RUNNING: return "APP_MSG_APP_NOT_RUNNING";
-    case APP_MSG_INVALID_ARGS: return "APP_MSG_INVALID_ARGS";
-    case APP_MSG_BUSY: return "APP_MSG_BUSY";
-    case APP_MSG_BUFFER_OVERFLOW: return "APP_MSG_BUFFER_OVERFLOW";
-    case APP_MSG_ALREADY_RELEASED: return "APP_MSG_ALREADY_RELEASED";
-    case APP_MSG_CALLBACK_ALREADY_REGISTERED: return "APP_MSG_CALLBACK_ALREADY_REGISTERED";
-    case APP_MSG_CALLBACK_NOT_REGISTERED: return "APP_MSG_CALLBACK_NOT_REGISTERED";
-    case APP_MSG_OUT_OF_MEMORY: return "APP_MSG_OUT_OF_MEMORY";
-    case APP_MSG_CLOSED: return "APP_MSG_CLOSED";
-    case APP_MSG_INTERNAL_ERROR: return "APP_MSG_INTERNAL_ERROR";
-    default: return "UNKNOWN ERROR";
+	case APP_MSG_OK: return "APP_MSG_OK";
+	case APP_MSG_SEND_TIMEOUT: return "APP_MSG_SEND_TIMEOUT";
+	case APP_MSG_SEND_REJECTED: return "APP_MSG_SEND_REJECTED";
+	case APP_MSG_NOT_CONNECTED: return "APP_MSG_NOT_CONNECTED";
+	case APP_MSG_APP_NOT_RUNNING: return "APP_MSG_APP_NOT_RUNNING";
+	case APP_MSG_INVALID_ARGS: return "APP_MSG_INVALID_ARGS";
+	case APP_MSG_BUSY: return "APP_MSG_BUSY";
+	case APP_MSG_BUFFER_OVERFLOW: return "APP_MSG_BUFFER_OVERFLOW";
+	case APP_MSG_ALREADY_RELEASED: return "APP_MSG_ALREADY_RELEASED";
+	case APP_MSG_CALLBACK_ALREADY_REGISTERED: return "APP_MSG_CALLBACK_ALREADY_REGISTERED";
+	case APP_MSG_CALLBACK_NOT_REGISTERED: return "APP_MSG_CALLBACK_NOT_REGISTERED";
+	case APP_MSG_OUT_OF_MEMORY: return "APP_MSG_OUT_OF_MEMORY";
+	case APP_MSG_CLOSED: return "APP_MSG_CLOSED";
+	case APP_MSG_INTERNAL_ERROR: return "APP_MSG_INTERNAL_ERROR";
+	default: return "UNKNOWN ERROR";
   }
 }
 
 #endif
 
-static void app_timer_accl_stop(void* data) {
-
-    if(acclStart != NULL){
-        if(app_timer_reschedule(acclStart, 5000)) {
-            app_timer_cancel(acclStart);
-        }
-        acclStart = NULL;
-    }
-    
-    if(acclStop != NULL){
-        acclStop = NULL;
-    }
-
-    // set report flag to false to indicate we want to pause reporting accl data
-    report_accl = 0;
-    accl_deinit();
-    
-    // set timer that will start reporting accl data after two minutes
-    acclStart = app_timer_register(curFreq * 2 * 60 * 1000, app_timer_accl_start,NULL);
-}
-
-static void app_timer_accl_start(void* data) {
-    
-    if(acclStop != NULL){
-        if(app_timer_reschedule(acclStop, 5000)) {
-            app_timer_cancel(acclStop);
-        }
-        acclStop = NULL;
-    }
-    
-    if(acclStart != NULL){
-        acclStart = NULL;
-    }
-
-
+#ifdef STRAP_STATS
+#define STATS_REPORT_EVERY 6  // battery reports, so every 30 minutes at STRAP_FREQ_HIGH
 
-    accl_init();
-    
-    // set timer that will stop reporting accl data after about one minute
-    acclStop = app_timer_register(80 * 1000, app_timer_accl_stop,NULL);
+static void log_stats_line(char* line) {
+	log_action(line);
 }
+#endif
 
 static void app_timer_battery(void* data) {
-    if(battTimer != NULL){
-        if(app_timer_reschedule(battTimer, 5000)) {
-            app_timer_cancel(battTimer);
-        }
-        battTimer = NULL;
-    }
-
-    char buffer[25];
-    memset(buffer, 0, sizeof(buffer));
-    snprintf(buffer, sizeof(buffer) - 1, "STRAP_API_BATTERY/%d", battery_state_service_peek().charge_percent);
-
-    strap_log_action(buffer);
+	STATS(stats_wakeup(STATS_WAKE_TIMER));
+	if(battTimer != NULL){
+		if(app_timer_reschedule(battTimer, 5000)) {
+			app_timer_cancel(battTimer);
+		}
+		battTimer = NULL;
+	}
+
+	battPercent = battery_state_service_peek().charge_percent;
+	battPending = true;
+	outbox_kick();
+
+#ifdef STRAP_STATS
+	static int reports = 0;
+	if(++reports % STATS_REPORT_EVERY == 0){
+		stats_report(log_stats_line);
+	}
+#endif
     
-    battTimer = app_timer_register(curFreq * 5 * 60 * 1000, app_timer_battery,NULL);
+	battTimer = app_timer_register(curFreq * 5 * 60 * 1000, app_timer_battery,NULL);
 }
 
 static bool is_log_available() {
-    if(curLog > 0){
-        return true;
-    }
-    return false;
+	return logLen > 0;
 }
 
+// strap, accl and the battery report share the outbox through outbox.c,
+// which registers these; apps that route AppMessage callbacks themselves
+// forward them here
 void strap_out_sent_handler(DictionaryIterator *iter, void *context)
 {
-        if(is_log_available()) {
-        send_next_log(NULL);
-    }
+	outbox_sent_handler(iter, context);
+}
+
+// strap registers this itself; an app with its own inbox handler should
+// register that instead and pass every message on to this
+void strap_in_received_handler(DictionaryIterator *iter, void *context)
+{
+	config_apply(iter);
 }
 
 void strap_out_failed_handler(DictionaryIterator *iter, AppMessageResult result, void *context)
 {
-    if(is_log_available()) {
-        send_next_log(NULL);
-    }
 #ifdef DEBUG
-    app_log(APP_LOG_LEVEL_INFO, "outfailed", 0, translate_error(result));
+	app_log(APP_LOG_LEVEL_INFO, "outfailed", 0, translate_error(result));
 #endif
+	outbox_failed_handler(iter, result, context);
 }
 
-void strap_init() {
-    memset(cur_activity, 0, sizeof(cur_activity));
-    strap_set_activity("UNKNOWN");
-    app_message_register_outbox_sent(strap_out_sent_handler);
-    app_message_register_outbox_failed(strap_out_failed_handler);
+// log source: the oldest queued record, topped up from the spool first
+static bool log_ready() {
+	if(!spool_empty()){
+		spool_drain(appendLog);
+	}
+	return is_log_available();
+}
+
+static uint16_t log_depth() {
+	return logLen;
+}
+
+// the event a queued record holds
+static void log_record_event(const LogRecord* rec, StrapEvent* event) {
+	event->id = rec->id;
+	event->arg = rec->arg;
+	event->path = rec->id == STRAP_EV_PATH ? logpaths[pathHead] : NULL;
+}
+
+// takes the oldest record, and its path, off the queue
+static void log_pop() {
+	if(logqueue[logHead].id == STRAP_EV_PATH){
+		pathHead = (pathHead + 1) % LOG_PATHS;
+		pathLen--;
+	}
+	logHead = (logHead + 1) % LOG_ROWS;
+	logLen--;
+}
+
+static void log_write(DictionaryIterator *iter) {
+	LogRecord* rec = &logqueue[logHead];
+	StrapEvent event;
+	log_record_event(rec, &event);
+	write_log(iter, &event, rec->count, rec->time);
+	logInflight = true;
+}
+
+// the record leaves the queue once the phone has it
+static void log_sent() {
+	if(logInflight && logLen > 0){
+		log_pop();
+	}
+	logInflight = false;
+}
+
+static void log_failed(AppMessageResult result) {
+	logInflight = false;
+}
+
+static const OutboxSource log_source = {
+	.priority = 1,
+	.deadline_ms = 1000,
+	.ready = log_ready,
+	.depth = log_depth,
+	.write = log_write,
+	.sent = log_sent,
+	.failed = log_failed,
+};
+
+// battery source: sent as a log event, behind the other traffic
+static bool battery_ready() {
+	return battPending;
+}
+
+static void battery_write(DictionaryIterator *iter) {
+	StrapEvent event = { .id = STRAP_EV_BATTERY, .arg = battPercent };
+	write_log(iter, &event, 1, 0);
+}
+
+static void battery_sent() {
+	battPending = false;
+}
+
+static const OutboxSource battery_source = {
+	.priority = 2,
+	.deadline_ms = 10000,
+	.ready = battery_ready,
+	.write = battery_write,
+	.sent = battery_sent,
+};
+
+// events logged while the phone was away are spooled; send them once it
+// is back, and keep the spool in storage while it is gone
+static void strap_bt_handler(bool connected) {
+	if(connected){
+		outbox_kick();
+	}
+	else {
+		spool_logs();
+	}
+}
+
+// strap owns the tap service, as it does the accel data service, and
+// passes taps on to the app
+static void strap_tap_handler(AccelAxisType axis, int32_t direction) {
+	STATS(stats_tap());
+	if(tapHandler) {
+		tapHandler(axis, direction);
+	}
+}
 
-    // start sending accl data in 30 seconds
-    #ifndef DISABLE_ACCL
-        acclStart = app_timer_register(30 * 1000, app_timer_accl_start,NULL);
-    #endif
-    battTimer = app_timer_register(1 * 10 * 1000, app_timer_battery,NULL);
-    //app_timer_register(30 * 1000,log_timer, NULL);
-    app_timer_register(1  * 1000,log_action,"STRAP_START");
+void strap_init() {
+	STATS(stats_init());
+	outbox_init();
+	outbox_register(OUTBOX_SRC_LOG, &log_source);
+	outbox_register(OUTBOX_SRC_BATTERY, &battery_source);
+	spool_init();
+	bluetooth_connection_service_subscribe(strap_bt_handler);
+	accl_init();
+	accel_tap_service_subscribe(strap_tap_handler);
+	app_message_register_inbox_received(strap_in_received_handler);
+
+	// the first look at accl data is in 30 seconds, or as soon as the
+	// wearer moves
+	#ifndef DISABLE_ACCL
+		duty_init(30 * 1000);
+	#endif
+	battTimer = app_timer_register(1 * 10 * 1000, app_timer_battery,NULL);
+	//app_timer_register(30 * 1000,log_timer, NULL);
+	app_timer_register(1  * 1000,log_start,NULL);
 }
 
 void strap_deinit() {
-    strap_log_action("STRAP_FINISH");
-    accl_deinit();
+	STATS(stats_report(log_stats_line));
+	strap_log_code(STRAP_EV_FINISH, 0);
+	accl_deinit();
+	accel_tap_service_unsubscribe();
+	outbox_deinit();
+	bluetooth_connection_service_unsubscribe();
+
+	// whatever the phone has not taken yet waits for the next launch
+	spool_logs();
+	spool_deinit();
+	STATS(stats_deinit());
 }
 
 // deprecated
 void strap_log_action(char* path) {
-    log_action(path);
+	log_action(path);
 }
 
+// paths that are in events.def are sent as their code
 void strap_log_event(char* path) {
-    log_action(path);
+	log_action(path);
+}
+
+void strap_log_code(StrapEventId id, uint16_t arg) {
+	StrapEvent event = { .id = id, .arg = arg };
+	log_event(&event);
+}
+
+static bool appendLog(const StrapEvent* event, uint16_t count, uint32_t time){
+	if(logLen > 0){
+		uint8_t newest = (logHead + logLen - 1) % LOG_ROWS;
+		LogRecord* rec = &logqueue[newest];
+		// the record in the outbox has already been written out
+		bool sending = logInflight && logLen == 1;
+		if(!sending && rec->time == time && rec->count <= UINT16_MAX - count
+				&& rec->id == event->id && rec->arg == event->arg
+				&& (event->id != STRAP_EV_PATH || strncmp(event->path,
+					logpaths[(pathHead + pathLen - 1) % LOG_PATHS], LOG_COLS - 1) == 0)){
+			rec->count += count;
+			return true;
+		}
+	}
+	if(logLen == LOG_ROWS){
+		// logqueue is full
+		return false;
+	}
+	if(event->id == STRAP_EV_PATH){
+		if(pathLen == LOG_PATHS){
+			return false;
+		}
+		char* path = logpaths[(pathHead + pathLen) % LOG_PATHS];
+		memset(path, 0, LOG_COLS);
+		strncpy(path, event->path, LOG_COLS - 1);
+		pathLen++;
+	}
+	LogRecord* rec = &logqueue[(logHead + logLen) % LOG_ROWS];
+	rec->id = event->id;
+	rec->arg = event->arg;
+	rec->count = count;
+	rec->time = time;
+	logLen++;
+	return true;
 }
 
-static void appendLog(char* path){
-    if(curLog == LOG_ROWS){
-        // logqueue is full
-        return;
-    }
-    memset(logqueue[curLog],0,LOG_COLS);
-    strncpy(logqueue[curLog], path, LOG_COLS - 1);
-    curLog++;
+// moves the queue into the spool, live events stamped with the time now
+static void spool_logs() {
+	uint32_t now = time(NULL);
+	logInflight = false;
+	while(logLen > 0){
+		LogRecord* rec = &logqueue[logHead];
+		StrapEvent event;
+		log_record_event(rec, &event);
+		spool_append(&event, rec->count, rec->time ? rec->time : now);
+		log_pop();
+	}
 }
 
 #ifdef DEBUG
+static const char* event_path(const StrapEvent* event) {
+	if(event->id == STRAP_EV_PATH){
+		return event->path;
+	}
+	return event->id < STRAP_EV_COUNT ? eventPaths[event->id] : "?";
+}
+
 static void plogs() {
-    for(int i = 0; i < curLog; i++){
-        app_log(APP_LOG_LEVEL_INFO, "log", 0, logqueue[i]);
-    }
+	for(int i = 0; i < logLen; i++){
+		LogRecord* rec = &logqueue[(logHead + i) % LOG_ROWS];
+		app_log(APP_LOG_LEVEL_INFO, "log", 0, rec->id == STRAP_EV_PATH ?
+			"(path)" : eventPaths[rec->id]);
+	}
 }
 #endif
 
-static void send_next_log(void* data) {
-    int tmpLog = curLog;
-    curLog = 0;
-    char buffer[LOG_COLS];
-    
-    if(tmpLog > 0){
-        strcpy(buffer, logqueue[0]);
-        
-        for(int i = 1; i < tmpLog; i++){
-            strcpy(logqueue[i - 1], logqueue[i]);
-            curLog++;
-        }
-        
-        log_action(buffer);
-    }
-    
+static void log_start(void* data) {
+	strap_log_code(STRAP_EV_START, 0);
 }
 
 static void log_action(void* vpath) {
-    char* path = (char*)vpath;
+	char* path = (char*)vpath;
+	StrapEvent event = { .id = STRAP_EV_PATH, .path = path };
     
-    if(vpath == NULL){
+	if(vpath == NULL){
 #ifdef DEBUG
-        app_log(APP_LOG_LEVEL_INFO, "vpath", 0, "vpath is NULL");
+		app_log(APP_LOG_LEVEL_INFO, "vpath", 0, "vpath is NULL");
 #endif
-        path = "";
-    }
+		event.path = "";
+	}
+	else {
+		for(uint8_t i = 0; i < STRAP_EV_COUNT; i++){
+			if(strcmp(path, eventPaths[i]) == 0){
+				event.id = i;
+				break;
+			}
+		}
+	}
+	log_event(&event);
+}
+
+static void log_event(const StrapEvent* event) {
+	STATS(uint64_t started = stats_clock());
     
-    if(!bluetooth_connection_service_peek()) {
+	if(!bluetooth_connection_service_peek()) {
 #ifdef DEBUG
-        app_log(APP_LOG_LEVEL_INFO, "btdropmsg", 0, (char*)vpath);
+		app_log(APP_LOG_LEVEL_INFO, "btspoolmsg", 0, event_path(event));
 #endif
-        return;
-    }
+		if(!spool_append(event, 1, time(NULL))){
+			logDropped++;
+		}
+		return;
+	}
     
 #ifdef DEBUG
-    app_log(APP_LOG_LEVEL_INFO, "action", 0, path);
+	app_log(APP_LOG_LEVEL_INFO, "action", 0, event_path(event));
 #endif
 
-    DictionaryIterator *iter;
-    AppMessageResult amr = app_message_outbox_begin(&iter);
-    if(amr != APP_MSG_OK){
+	// queue first so the event keeps its place behind older ones
+	if(!appendLog(event, 1, 0)){
+		logDropped++;
+	}
 #ifdef DEBUG
-        app_log(APP_LOG_LEVEL_INFO, "logdropmsg", 0, translate_error(amr));
-        app_log(APP_LOG_LEVEL_INFO, "logdropmsg", 0, path);
+	plogs();
 #endif
-        if(amr == APP_MSG_BUSY){
-            appendLog(path);
-#ifdef DEBUG
-            app_log(APP_LOG_LEVEL_INFO, "appendLog", 0, path);
-            plogs();
-#endif
-        }
-        return;
-    }
-#ifdef DEBUG
-    app_log(APP_LOG_LEVEL_INFO, "wasokay", 0, path);
-#endif
-    Tuplet t = TupletStaticCString(KEY_OFFSET + T_LOG, path, strlen(path));
-    
-    if(dict_write_tuplet(iter, &t) == DICT_OK) {
-        if(dict_write_end(iter) != 0){
-            app_message_outbox_send();
+	outbox_kick();
+	STATS(stats_handler(STATS_H_LOG, started));
+}
+
+// known events go as one integer: the code in the low byte and, for those
+// that carry one, the number above it, in as few bytes as it takes
+static DictionaryResult write_event(DictionaryIterator *iter, const StrapEvent* event) {
+	if(event->id == STRAP_EV_PATH){
+		Tuplet t = TupletStaticCString(KEY_OFFSET + T_LOG, event->path, strlen(event->path));
+		return dict_write_tuplet(iter, &t);
+	}
+	uint32_t value = event->id | (uint32_t)event->arg << 8;
+	Tuplet t = value <= UINT8_MAX ? TupletInteger(KEY_OFFSET + T_LOG_EVENT, (uint8_t)value)
+		: value <= UINT16_MAX ? TupletInteger(KEY_OFFSET + T_LOG_EVENT, (uint16_t)value)
+		: TupletInteger(KEY_OFFSET + T_LOG_EVENT, value);
+	return dict_write_tuplet(iter, &t);
+}
+
+static void write_log(DictionaryIterator *iter, const StrapEvent* event, uint16_t count, uint32_t time) {
 #ifdef DEBUG
-            app_log(APP_LOG_LEVEL_INFO, "osend", 0, path);
+	app_log(APP_LOG_LEVEL_INFO, "wasokay", 0, event_path(event));
 #endif
-        }
-    }
-    else {
+	if(write_event(iter, event) == DICT_OK) {
+		if(count > 1){
+			Tuplet c = TupletInteger(KEY_OFFSET + T_LOG_COUNT, (uint32_t)count);
+			dict_write_tuplet(iter, &c);
+		}
+		if(time){
+			Tuplet ts = TupletInteger(KEY_OFFSET + T_LOG_TIME, time);
+			dict_write_tuplet(iter, &ts);
+		}
+	}
+	else {
 #ifdef DEBUG
-        app_log(APP_LOG_LEVEL_INFO, "dictbad", 0, path);
+		app_log(APP_LOG_LEVEL_INFO, "dictbad", 0, event_path(event));
 #endif
-    }
+	}
 }
 
 void strap_set_activity(char* act) {
-    strncpy(cur_activity, act, sizeof(cur_activity) - 1);
+	accl_set_activity(act);
+}
+
+void strap_set_accel_handler(AccelDataHandler handler) {
+	accl_set_observer(handler);
+}
+
+void strap_set_tap_handler(AccelTapHandler handler) {
+	tapHandler = handler;
+}
+
+void strap_set_accel_mode(int mode) {
+	accl_set_mode(mode == STRAP_ACCEL_FEATURES ? ACCL_MODE_FEATURES : ACCL_MODE_SAMPLES);
 }
 
 void strap_set_freq(int freq) {
-    curFreq = freq;
+	curFreq = freq;
+	duty_set_freq(freq);
 }
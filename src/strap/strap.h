@@ -1,22 +1,36 @@
 #ifndef STRAP_H
 #define STRAP_H
 
+#include "events.h"
+#include "message.h"
+
 #define STRAP_FREQ_HIGH     1  // more data collection, but higher power drain
 #define STRAP_FREQ_MED      2  // less data collection, with moderate power drain
 #define STRAP_FREQ_LOW      3  // least data collection, lowest power drain
 
+#define STRAP_ACCEL_SAMPLES  0  // streams send every sample
+#define STRAP_ACCEL_FEATURES 1  // streams send a summary of every 5 s, a fraction of the bytes
+
 // #define DISABLE_ACCL 
 
 // #define DEBUG
+
+// counters, a debug window and a log report; see stats.h
+// #define STRAP_STATS
   
 void strap_init();
 void strap_deinit();
 void strap_log_action(char *);
 void strap_log_event(char *);
+void strap_log_code(StrapEventId, uint16_t);
+void strap_in_received_handler(DictionaryIterator *, void *);
 void strap_out_sent_handler(DictionaryIterator *, void *);
 void strap_out_failed_handler(DictionaryIterator *, AppMessageResult , void *);
 void strap_set_activity(char*);
 void strap_set_freq(int);
+void strap_set_accel_mode(int);
+void strap_set_accel_handler(AccelDataHandler);
+void strap_set_tap_handler(AccelTapHandler);
 
 #endif
 
@@ -0,0 +1,55 @@
+// ==========================================================================
+// gen_events.js
+//
+// Writes the phone's copy of src/strap/events.def into pebble-js-app.js,
+// between the "events.def" markers, so the codes the watch sends map back
+// to the same paths:
+//
+//   node tools/gen_events.js           rewrite the table
+//   node tools/gen_events.js --check   exit 1 if it is out of date
+// ==========================================================================
+var fs = require("fs");
+var path = require("path");
+
+var root = path.join(__dirname, "..");
+var defPath = path.join(root, "src", "strap", "events.def");
+var jsPath = path.join(root, "src", "js", "pebble-js-app.js");
+var BEGIN = "// -- events.def, written by tools/gen_events.js; do not edit";
+var END = "// -- end of events.def";
+
+var events = [];
+fs.readFileSync(defPath, "utf8").split("\n").forEach(function(line) {
+    var m = /^STRAP_EVENT\((\w+),\s*("[^"]*"),\s*([01])\)/.exec(line);
+    if (m) events.push("    [" + m[2] + ", " + (m[3] == "1") + "]  // " + m[1]);
+});
+
+var table = [
+    BEGIN,
+    "// [path, carries a number], by code",
+    "var strap_api_events = [",
+    events.map(function(e, i) {
+        // the comma goes before the comment
+        return i < events.length - 1 ? e.replace("]  //", "], //") : e;
+    }).join("\n"),
+    "];",
+    END
+].join("\n");
+
+var js = fs.readFileSync(jsPath, "utf8");
+var begin = js.indexOf(BEGIN);
+var end = js.indexOf(END);
+if (begin < 0 || end < begin) {
+    console.error(jsPath + ": no events.def markers");
+    process.exit(2);
+}
+var updated = js.slice(0, begin) + table + js.slice(end + END.length);
+
+if (process.argv.indexOf("--check") >= 0) {
+    if (updated != js) {
+        console.error("pebble-js-app.js is out of date; run tools/gen_events.js");
+        process.exit(1);
+    }
+} else if (updated != js) {
+    fs.writeFileSync(jsPath, updated);
+    console.log("wrote " + events.length + " events");
+}
@@ -0,0 +1,189 @@
+/* ========================================================================== */
+/* File: bench_codec.c
+ *
+ * Encodes a recorded or synthesized trace with every frame encoding in
+ * src/strap/frame.c and reports bytes per sample, compression ratio against
+ * the raw frame and encode cost per sample.
+ *
+ * Usage:
+ *
+ *   bench_codec [--trace file.csv | --synth kind] [--rate hz] [--batch n]
+ *               [--frame-bytes n] [--dump frames.jsonl] [--samples in.csv]
+ *
+ * --dump writes the delta frames in the replay dump format so
+ * companion.js can decode them; --samples writes the encoded input, so the
+ * two CSVs can be diffed to check the JS decoder bit for bit.
+ */
+/* ========================================================================== */
+#define PEBBLE_SHIM_IMPL // host malloc and clock, this is not app code
+
+#include <pebble.h>
+#include <time.h>
+
+#include "../../src/strap/frame.h"
+#include "shim.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#endif
+
+#define KEY_FRAME (48000 + 4000)
+#define REPEATS 50
+
+typedef struct {
+	uint64_t bytes;
+	uint32_t frames;
+	double ns;
+	double cycles;
+} Result;
+
+static AccelData *resample(const ShimSample *trace, uint32_t len,
+		uint32_t rate, uint32_t *out_n) {
+	uint32_t span = trace[len - 1].t_ms + 1;
+	uint32_t n = (uint64_t)span * rate / 1000;
+	AccelData *samples = malloc(n * sizeof(*samples));
+	uint32_t j = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		uint32_t t = (uint64_t)i * 1000 / rate;
+		while (j + 1 < len && trace[j + 1].t_ms <= t) {
+			j++;
+		}
+		samples[i] = (AccelData) {
+			.x = trace[j].x, .y = trace[j].y, .z = trace[j].z,
+			.timestamp = 1402819200000ull + t,
+		};
+	}
+	*out_n = n;
+	return samples;
+}
+
+// writes a frame as the outbox message replay --dump would record
+static void dump_frame(FILE *dump, const uint8_t *buf, uint16_t len) {
+	if (!dump) {
+		return;
+	}
+	fprintf(dump, "{\"t\":0,\"payload\":{\"%d\":[", KEY_FRAME);
+	for (int i = 0; i < len; i++) {
+		fprintf(dump, "%s%u", i ? "," : "", buf[i]);
+	}
+	fprintf(dump, "]}}\n");
+}
+
+// packs batches into frames of at most frame_bytes, the way accl.c does
+static Result encode(const AccelData *samples, uint32_t n, uint32_t rate,
+		uint32_t batch, uint16_t frame_bytes, uint8_t enc, FILE *dump) {
+	Result r = { 0 };
+	uint8_t *buf = malloc(frame_bytes);
+	struct timespec t0, t1;
+#ifdef HAVE_RDTSC
+	uint64_t c0 = __rdtsc();
+#endif
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (int rep = 0; rep < (dump ? 1 : REPEATS); rep++) {
+		Frame frame;
+		frame_begin(&frame, buf, frame_bytes, enc, rate);
+		for (uint32_t i = 0; i < n; i += batch) {
+			uint32_t k = n - i < batch ? n - i : batch;
+			if (!frame_add(&frame, samples + i, k)) {
+				uint16_t len = frame_end(&frame);
+				if (rep == 0) {
+					r.bytes += len;
+					r.frames++;
+					dump_frame(dump, buf, len);
+				}
+				frame_begin(&frame, buf, frame_bytes, enc, rate);
+				frame_add(&frame, samples + i, k);
+			}
+		}
+		uint16_t len = frame_end(&frame);
+		if (rep == 0 && frame.count) {
+			r.bytes += len;
+			r.frames++;
+			dump_frame(dump, buf, len);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	int reps = dump ? 1 : REPEATS;
+	r.ns = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec))
+		/ ((double)n * reps);
+#ifdef HAVE_RDTSC
+	r.cycles = (double)(__rdtsc() - c0) / ((double)n * reps);
+#endif
+	free(buf);
+	return r;
+}
+
+int main(int argc, char **argv) {
+	const char *trace_path = NULL, *synth = "mixed";
+	const char *dump_path = NULL, *samples_path = NULL;
+	uint32_t rate = 10, batch = 10, frame_bytes = 600;
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (!strcmp(argv[i], "--trace")) {
+			trace_path = argv[i + 1];
+		} else if (!strcmp(argv[i], "--synth")) {
+			synth = argv[i + 1];
+		} else if (!strcmp(argv[i], "--rate")) {
+			rate = atoi(argv[i + 1]);
+		} else if (!strcmp(argv[i], "--batch")) {
+			batch = atoi(argv[i + 1]);
+		} else if (!strcmp(argv[i], "--frame-bytes")) {
+			frame_bytes = atoi(argv[i + 1]);
+		} else if (!strcmp(argv[i], "--dump")) {
+			dump_path = argv[i + 1];
+		} else if (!strcmp(argv[i], "--samples")) {
+			samples_path = argv[i + 1];
+		}
+	}
+
+	ShimSample *trace = NULL;
+	uint32_t len = trace_path ? shim_load_trace(trace_path, &trace)
+		: shim_synth_trace(synth, 240, 1, &trace);
+	if (!len || !rate || !batch) {
+		fprintf(stderr, "nothing to encode\n");
+		return 1;
+	}
+	uint32_t n;
+	AccelData *samples = resample(trace, len, rate, &n);
+
+	printf("%u samples at %u Hz, batches of %u, frames up to %u bytes\n",
+		n, rate, batch, frame_bytes);
+	printf("%-6s %10s %8s %8s %8s %10s\n", "enc", "bytes", "frames",
+		"B/sample", "ratio", "ns/sample");
+
+	Result raw = encode(samples, n, rate, batch, frame_bytes, FRAME_ENC_RAW, NULL);
+	Result delta = encode(samples, n, rate, batch, frame_bytes, FRAME_ENC_DELTA,
+		NULL);
+	Result *results[] = { &raw, &delta };
+	const char *names[] = { "raw", "delta" };
+	for (int i = 0; i < 2; i++) {
+		Result *r = results[i];
+		printf("%-6s %10llu %8u %8.2f %8.2f %10.1f", names[i],
+			(unsigned long long)r->bytes, r->frames, (double)r->bytes / n,
+			(double)raw.bytes / r->bytes, r->ns);
+#ifdef HAVE_RDTSC
+		printf("  (%.0f cycles)", r->cycles);
+#endif
+		printf("\n");
+	}
+
+	if (dump_path) {
+		FILE *dump = fopen(dump_path, "w");
+		encode(samples, n, rate, batch, frame_bytes, FRAME_ENC_DELTA, dump);
+		fclose(dump);
+	}
+	if (samples_path) {
+		FILE *out = fopen(samples_path, "w");
+		for (uint32_t i = 0; i < n; i++) {
+			fprintf(out, "%llu,%d,%d,%d,%d\n",
+				(unsigned long long)samples[i].timestamp, samples[i].x,
+				samples[i].y, samples[i].z, samples[i].did_vibrate);
+		}
+		fclose(out);
+	}
+
+	free(samples);
+	free(trace);
+	return 0;
+}
@@ -0,0 +1,257 @@
+/* ========================================================================== */
+/* File: bench_features.c
+ *
+ * Runs a recorded or synthesized trace through the feature kernel in
+ * src/strap/feature.c and reports its cost per sample and how far each
+ * feature is from a double precision reference computed over the same
+ * windows.
+ *
+ * Usage:
+ *
+ *   bench_features [--trace file.csv | --synth kind] [--rate hz] [--batch n]
+ *                  [--seconds n]
+ *
+ * The reference measures crossings and bands about each window's own
+ * mean; the kernel uses the previous window's, which shows up in the
+ * crossings error around changes of activity.
+ */
+/* ========================================================================== */
+#define PEBBLE_SHIM_IMPL // host malloc and clock, this is not app code
+
+#include <pebble.h>
+#include <math.h>
+#include <time.h>
+
+#include "../../src/strap/feature.h"
+#include "shim.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#endif
+
+#define REPEATS 50
+#define MAX_WINDOWS 4096
+
+typedef struct {
+	double mean[3], var[3], p2p[3];
+	double mag_mean, mag_var, mag_p2p;
+	double crossings;
+	double bins[FEATURE_BINS];
+	int dominant;
+} Reference;
+
+typedef struct {
+	const char *name;
+	double sum;
+	double max;
+	uint32_t n;
+} Error;
+
+static FeatureWindow windows[MAX_WINDOWS];
+static uint32_t num_windows;
+static bool collect;
+
+static void on_window(const FeatureWindow *w) {
+	if (collect && num_windows < MAX_WINDOWS) {
+		windows[num_windows++] = *w;
+	}
+}
+
+static AccelData *resample(const ShimSample *trace, uint32_t len,
+		uint32_t rate, uint32_t seconds, uint32_t *out_n) {
+	uint32_t span = trace[len - 1].t_ms + 1;
+	uint32_t n = (uint64_t)seconds * rate;
+	AccelData *samples = malloc(n * sizeof(*samples));
+	uint32_t j = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		uint32_t t = (uint64_t)i * 1000 / rate;
+		uint32_t tt = t % span;
+		if (tt < trace[j].t_ms) {
+			j = 0;
+		}
+		while (j + 1 < len && trace[j + 1].t_ms <= tt) {
+			j++;
+		}
+		samples[i] = (AccelData) {
+			.x = trace[j].x, .y = trace[j].y, .z = trace[j].z,
+			.timestamp = 1402819200000ull + t,
+		};
+	}
+	*out_n = n;
+	return samples;
+}
+
+static void reference(const AccelData *s, uint32_t n, Reference *r) {
+	double mag[255];
+	memset(r, 0, sizeof(*r));
+	for (int a = 0; a < 3; a++) {
+		double lo = 1e9, hi = -1e9, sq = 0;
+		for (uint32_t i = 0; i < n; i++) {
+			double v = a == 0 ? s[i].x : a == 1 ? s[i].y : s[i].z;
+			r->mean[a] += v / n;
+			sq += v * v / n;
+			lo = fmin(lo, v);
+			hi = fmax(hi, v);
+		}
+		r->var[a] = sq - r->mean[a] * r->mean[a];
+		r->p2p[a] = hi - lo;
+	}
+
+	double lo = 1e9, hi = -1e9, sq = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		mag[i] = sqrt((double)s[i].x * s[i].x + (double)s[i].y * s[i].y
+			+ (double)s[i].z * s[i].z);
+		r->mag_mean += mag[i] / n;
+		sq += mag[i] * mag[i] / n;
+		lo = fmin(lo, mag[i]);
+		hi = fmax(hi, mag[i]);
+	}
+	r->mag_var = sq - r->mag_mean * r->mag_mean;
+	r->mag_p2p = hi - lo;
+
+	bool above = mag[0] > r->mag_mean;
+	for (uint32_t i = 1; i < n; i++) {
+		double v = mag[i] - r->mag_mean;
+		if (above ? v < -FEATURE_CROSS_MG : v > FEATURE_CROSS_MG) {
+			above = !above;
+			r->crossings++;
+		}
+	}
+
+	// amplitude of a sine at each band, from the DFT of the magnitude
+	for (int b = 0; b < FEATURE_BINS; b++) {
+		int k = FEATURE_BIN_FIRST + b * FEATURE_BIN_STEP;
+		double re = 0, im = 0;
+		for (uint32_t i = 0; i < n; i++) {
+			re += (mag[i] - r->mag_mean) * cos(2 * M_PI * k * i / n);
+			im -= (mag[i] - r->mag_mean) * sin(2 * M_PI * k * i / n);
+		}
+		r->bins[b] = 2 * sqrt(re * re + im * im) / n;
+		if (r->bins[b] > r->bins[r->dominant]) {
+			r->dominant = b;
+		}
+	}
+}
+
+static void add(Error *e, double got, double want) {
+	double d = fabs(got - want);
+	e->sum += d;
+	e->max = fmax(e->max, d);
+	e->n++;
+}
+
+int main(int argc, char **argv) {
+	const char *trace_path = NULL, *synth = "mixed";
+	uint32_t rate = 10, batch = 10, seconds = 3600;
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (!strcmp(argv[i], "--trace")) {
+			trace_path = argv[i + 1];
+		} else if (!strcmp(argv[i], "--synth")) {
+			synth = argv[i + 1];
+		} else if (!strcmp(argv[i], "--rate")) {
+			rate = atoi(argv[i + 1]);
+		} else if (!strcmp(argv[i], "--batch")) {
+			batch = atoi(argv[i + 1]);
+		} else if (!strcmp(argv[i], "--seconds")) {
+			seconds = atoi(argv[i + 1]);
+		}
+	}
+
+	ShimSample *trace = NULL;
+	uint32_t len = trace_path ? shim_load_trace(trace_path, &trace)
+		: shim_synth_trace(synth, seconds, 1, &trace);
+	if (!len || !rate || !batch) {
+		fprintf(stderr, "nothing to measure\n");
+		return 1;
+	}
+	uint32_t n;
+	AccelData *samples = resample(trace, len, rate, seconds, &n);
+
+	feature_init(on_window);
+	feature_set_rate(rate);
+	uint32_t window = feature_window();
+	uint32_t stride = rate * FEATURE_WINDOW_MS / 1000 / window;
+	struct timespec t0, t1;
+#ifdef HAVE_RDTSC
+	uint64_t c0 = __rdtsc();
+#endif
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (int rep = 0; rep < REPEATS; rep++) {
+		collect = rep == 0;
+		feature_reset();
+		for (uint32_t i = 0; i < n; i += batch) {
+			feature_add(samples + i, n - i < batch ? n - i : batch);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	double ns = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec))
+		/ ((double)n * REPEATS);
+
+	printf("%u samples at %u Hz, windows of %u, %u bands from %.2f Hz by %.2f Hz\n",
+		n, rate, window, FEATURE_BINS,
+		FEATURE_BIN_FIRST * 1000.0 / FEATURE_WINDOW_MS,
+		FEATURE_BIN_STEP * 1000.0 / FEATURE_WINDOW_MS);
+	printf("kernel: %.1f ns/sample", ns);
+#ifdef HAVE_RDTSC
+	printf(" (%.0f cycles)", (double)(__rdtsc() - c0) / ((double)n * REPEATS));
+#endif
+	printf("\n\n");
+
+	Error errors[] = {
+		{ .name = "mean, mg" }, { .name = "std dev, mg" },
+		{ .name = "peak-to-peak, mg" }, { .name = "magnitude mean, mg" },
+		{ .name = "magnitude std, mg" }, { .name = "magnitude p-p, mg" },
+		{ .name = "crossings" }, { .name = "band amplitude, mg" },
+	};
+	// the reference sees the samples the kernel averages in pairs the same way
+	uint32_t kept = n / stride;
+	for (uint32_t i = 0; i < kept; i++) {
+		int32_t x = 0, y = 0, z = 0;
+		for (uint32_t j = 0; j < stride; j++) {
+			x += samples[i * stride + j].x;
+			y += samples[i * stride + j].y;
+			z += samples[i * stride + j].z;
+		}
+		samples[i].x = lround((double)x / stride);
+		samples[i].y = lround((double)y / stride);
+		samples[i].z = lround((double)z / stride);
+	}
+
+	uint32_t dominant_agrees = 0, windows_strong = 0;
+	for (uint32_t w = 0; w < num_windows; w++) {
+		const FeatureWindow *f = &windows[w];
+		Reference r;
+		reference(samples + w * window, f->count, &r);
+		for (int a = 0; a < 3; a++) {
+			add(&errors[0], f->mean[a], r.mean[a]);
+			add(&errors[1], sqrt(f->var[a]), sqrt(r.var[a]));
+			add(&errors[2], f->p2p[a], r.p2p[a]);
+		}
+		add(&errors[3], f->mag_mean, r.mag_mean);
+		add(&errors[4], sqrt(f->mag_var), sqrt(r.mag_var));
+		add(&errors[5], f->mag_p2p, r.mag_p2p);
+		add(&errors[6], f->crossings, r.crossings);
+		for (int b = 0; b < FEATURE_BINS; b++) {
+			add(&errors[7], f->bins[b], r.bins[b]);
+		}
+		// the strongest band only means something above the noise
+		if (r.bins[r.dominant] >= 20) {
+			windows_strong++;
+			dominant_agrees += f->dominant == r.dominant;
+		}
+	}
+
+	printf("%-22s %12s %12s\n", "feature", "mean error", "max error");
+	for (size_t i = 0; i < ARRAY_LENGTH(errors); i++) {
+		printf("%-22s %12.3f %12.3f\n", errors[i].name,
+			errors[i].n ? errors[i].sum / errors[i].n : 0, errors[i].max);
+	}
+	printf("dominant band:         %u of %u windows above 20 mg agree\n",
+		dominant_agrees, windows_strong);
+
+	free(samples);
+	free(trace);
+	return 0;
+}
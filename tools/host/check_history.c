@@ -0,0 +1,163 @@
+/* ========================================================================== */
+/* File: check_history.c
+ *
+ * Appends days to the day history in src/history.c against the shim's
+ * persistent storage and checks every read against what was appended,
+ * rounded the way the store rounds it: each day the ring holds, the days
+ * it has dropped, sums over ranges and a reload from storage. Exits 1 on
+ * the first mismatch.
+ *
+ * Usage:
+ *
+ *   check_history [--days n] [--seed n]
+ *
+ * Points run past 65535 now and then, to check they saturate rather than
+ * wrap, and about one day in ten is skipped, as when the app is not opened.
+ */
+/* ========================================================================== */
+#define PEBBLE_SHIM_IMPL // host malloc, this is not app code
+
+#include <pebble.h>
+
+#include "../../src/history.h"
+#include "shim.h"
+
+#define BASE_KEY 20
+#define FIRST_DAY 16000         // 2013-10-23
+#define MAX_DAYS 4096
+
+static HistoryDay expected[MAX_DAYS];
+static bool appended[MAX_DAYS];
+static uint32_t failures;
+
+static uint32_t rng = 1;
+static uint32_t random_below(uint32_t n) {
+	rng = rng * 1103515245 + 12345;
+	return (rng >> 8) % n;
+}
+
+static uint16_t round_to(uint32_t value, uint16_t unit, uint32_t max) {
+	uint32_t units = (value + unit / 2) / unit;
+	return (units < max ? units : max) * unit;
+}
+
+static void fail(const char *what, uint32_t day, uint32_t got, uint32_t want) {
+	if (failures++ < 10) {
+		fprintf(stderr, "day %u: %s is %u, expected %u\n", day, what, got, want);
+	}
+}
+
+static void check_day(uint32_t i, uint32_t days) {
+	HistoryDay got;
+	uint16_t day = FIRST_DAY + i;
+	bool held = i + HISTORY_DAYS >= days;
+	bool found = history_get(day, &got);
+
+	if (found != held) {
+		fail("held", day, found, held);
+		return;
+	}
+	if (!held) {
+		return;
+	}
+	const HistoryDay *want = &expected[i];
+	if (got.points != want->points) {
+		fail("points", day, got.points, want->points);
+	}
+	if (got.goal_met != want->goal_met) {
+		fail("goal", day, got.goal_met, want->goal_met);
+	}
+	if (got.minutes_worn != want->minutes_worn) {
+		fail("minutes worn", day, got.minutes_worn, want->minutes_worn);
+	}
+	if (got.active_minutes != want->active_minutes) {
+		fail("active minutes", day, got.active_minutes, want->active_minutes);
+	}
+}
+
+static void check_sum(uint32_t first, uint32_t last, uint32_t days) {
+	HistoryTotals got, want;
+
+	history_sum(FIRST_DAY + first, FIRST_DAY + last, &got);
+	memset(&want, 0, sizeof(want));
+	for (uint32_t i = first; i <= last; i++) {
+		if (i + HISTORY_DAYS >= days) {
+			history_add(&want, &expected[i]);
+		}
+	}
+	if (got.days != want.days || got.goals != want.goals
+			|| got.points != want.points
+			|| got.minutes_worn != want.minutes_worn
+			|| got.active_minutes != want.active_minutes) {
+		fail("sum of points", FIRST_DAY + first, got.points, want.points);
+	}
+}
+
+int main(int argc, char **argv) {
+	uint32_t days = 800;
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (!strcmp(argv[i], "--days")) {
+			days = atoi(argv[i + 1]);
+		} else if (!strcmp(argv[i], "--seed")) {
+			rng = atoi(argv[i + 1]);
+		}
+	}
+	if (!days || days > MAX_DAYS) {
+		fprintf(stderr, "--days runs from 1 to %d\n", MAX_DAYS);
+		return 2;
+	}
+
+	history_init(BASE_KEY);
+	uint64_t writes = shim_stats.persist_writes;
+	uint32_t steps_max = 0;
+	for (uint32_t i = 0; i < days; i++) {
+		// the last day is always appended, so the ring ends where days does
+		if (i + 1 < days && random_below(10) == 0) {
+			continue;
+		}
+		HistoryDay record = {
+			.points = random_below(20) ? random_below(25000) : 60000 + random_below(20000),
+			.goal_met = random_below(2),
+			.minutes_worn = random_below(1441),
+			.active_minutes = random_below(400),
+		};
+		history_append(FIRST_DAY + i, &record);
+		appended[i] = true;
+		expected[i] = (HistoryDay) {
+			.points = record.points < 0xffff ? record.points : 0xffff,
+			.goal_met = record.goal_met,
+			.minutes_worn = round_to(record.minutes_worn, 15, 0x7f),
+			.active_minutes = round_to(record.active_minutes, 5, 0xff),
+		};
+		if (expected[i].points > steps_max) {
+			steps_max = expected[i].points;
+		}
+	}
+	writes = shim_stats.persist_writes - writes;
+
+	for (int pass = 0; pass < 2; pass++) {
+		for (uint32_t i = 0; i < days; i++) {
+			check_day(i, days);
+		}
+		for (int n = 0; n < 200; n++) {
+			uint32_t a = random_below(days), b = random_below(days);
+			check_sum(a < b ? a : b, a < b ? b : a, days);
+		}
+		// again from storage, as after a restart of the app
+		history_init(BASE_KEY);
+	}
+
+	uint32_t held = 0;
+	for (uint32_t i = 0; i < days; i++) {
+		held += appended[i] && i + HISTORY_DAYS >= days;
+	}
+	printf("%u days, %u held in %d keys, %llu writes, most points %u\n", days,
+		held, HISTORY_KEYS, (unsigned long long) writes, steps_max);
+	if (failures) {
+		printf("%u mismatches\n", failures);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
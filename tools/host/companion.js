@@ -0,0 +1,317 @@
+// ==========================================================================
+// companion.js
+//
+// Runs src/js/pebble-js-app.js under node with PebbleKit JS stubbed out and
+// feeds it the outbox messages recorded by `replay --dump` at the times they
+// were sent. Uploads are answered by a fake server on a virtual clock, so an
+// hour of messages runs in a moment and the decoders can be checked end to
+// end:
+//
+//   node tools/host/companion.js dump.jsonl [--samples out.csv] [--app file.js]
+//       [--format json|col1] [--fail permille] [--latency ms] [--seed n]
+//       [--endpoint url [--speed n]] [--expect-samples n] [--expect-windows n]
+//
+// --app runs another version of the JS, to compare its cost per message.
+// --format picks the accel upload encoding. --fail answers that many posts
+// in a thousand with an error, half of them a 503 and half a lost
+// connection, and --latency delays every answer. --endpoint posts to a real
+// server such as endpoint.js instead, running the clock --speed times faster
+// than the dump (default 100). --expect-samples and --expect-windows exit
+// with 1 unless that many samples or feature windows were posted, so a run
+// with failures can be held to the count of a clean one.
+// ==========================================================================
+var fs = require("fs");
+var path = require("path");
+var vm = require("vm");
+var upload = require("./upload_decode");
+
+var args = process.argv.slice(2);
+var arg = function(name, dflt) {
+    return args.indexOf(name) >= 0 ? args[args.indexOf(name) + 1] : dflt;
+};
+var dumpPath = args[0];
+var samplesPath = arg("--samples", null);
+var appArg = arg("--app", null);
+var format = arg("--format", null);
+var endpoint = arg("--endpoint", null);
+var failPermille = parseInt(arg("--fail", "0"));
+var latencyMs = parseInt(arg("--latency", "0"));
+var speed = parseFloat(arg("--speed", "100"));
+var seed = parseInt(arg("--seed", "1"));
+var expectSamples = arg("--expect-samples", null);
+var expectWindows = arg("--expect-windows", null);
+if (!dumpPath) {
+    console.error("usage: companion.js dump.jsonl [--samples out.csv] [--app file.js]");
+    process.exit(2);
+}
+
+var listeners = {};
+var posts = [];
+var net = { attempts: 0, failed: 0, aborted: 0 };
+
+// counts what the JS moves through localStorage
+var storage = { writes: 0, written: 0, read: 0 };
+var localStorage = new Proxy({
+    removeItem: function(k) { delete this[k]; }
+}, {
+    get: function(t, k) {
+        var v = t[k];
+        if (typeof v == "string") storage.read += v.length;
+        return v;
+    },
+    set: function(t, k, v) {
+        t[k] = String(v);
+        storage.writes++;
+        storage.written += t[k].length;
+        return true;
+    }
+});
+
+// the virtual clock: timers run in order of when they are due, whenever
+// the clock is moved on
+var now = 0;
+var timers = {};
+var timerId = 0;
+var setVirtualTimeout = function(fn, ms) {
+    timers[++timerId] = { at: now + (ms || 0), id: timerId, fn: fn };
+    return timerId;
+};
+var clearVirtualTimeout = function(id) {
+    delete timers[id];
+};
+var runUntil = function(t) {
+    for (;;) {
+        var next = null;
+        for (var id in timers) {
+            if (timers[id].at <= t && (!next || timers[id].at < next.at ||
+                    timers[id].at == next.at && timers[id].id < next.id)) {
+                next = timers[id];
+            }
+        }
+        if (!next) break;
+        delete timers[next.id];
+        now = next.at;
+        next.fn();
+    }
+    now = Math.max(now, t);
+};
+
+// same sequence on every run, so failures land on the same posts
+var random = function() {
+    seed = (seed * 1103515245 + 12345) % 2147483648;
+    return seed / 2147483648;
+};
+
+function FakeXHR() {
+    this.headers = {};
+}
+FakeXHR.prototype.open = function(method, url) {
+    this.method = method;
+    this.url = url;
+};
+FakeXHR.prototype.setRequestHeader = function(k, v) {
+    this.headers[k] = v;
+};
+FakeXHR.prototype.abort = function() {
+    this.aborted = true;
+    net.aborted++;
+};
+FakeXHR.prototype.send = function(body) {
+    var xhr = this;
+    var roll = random() * 1000;
+    net.attempts++;
+    setVirtualTimeout(function() {
+        if (xhr.aborted) return;
+        xhr.readyState = 4;
+        if (roll < failPermille / 2) {
+            net.failed++;
+            xhr.status = 503;
+        } else if (roll < failPermille) {
+            net.failed++;
+            if (xhr.onerror) xhr.onerror({});
+            return;
+        } else {
+            posts.push({ url: xhr.url, headers: xhr.headers, body: body });
+            xhr.status = 200;
+        }
+        if (xhr.onload) xhr.onload({});
+    }, latencyMs);
+};
+
+// posts to --endpoint for real
+function HttpXHR() {
+    this.headers = {};
+}
+HttpXHR.prototype.open = FakeXHR.prototype.open;
+HttpXHR.prototype.setRequestHeader = FakeXHR.prototype.setRequestHeader;
+HttpXHR.prototype.abort = function() {
+    net.aborted++;
+    if (this.req) this.req.destroy();
+};
+HttpXHR.prototype.send = function(body) {
+    var xhr = this;
+    var url = require("url").parse(endpoint);
+    net.attempts++;
+    xhr.req = require("http").request({
+        hostname: url.hostname, port: url.port, path: url.path,
+        method: "POST", headers: xhr.headers
+    }, function(res) {
+        res.resume();
+        res.on("end", function() {
+            xhr.readyState = 4;
+            xhr.status = res.statusCode;
+            if (res.statusCode == 200) {
+                posts.push({ url: xhr.url, headers: xhr.headers, body: body });
+            } else {
+                net.failed++;
+            }
+            if (xhr.onload) xhr.onload({});
+        });
+    });
+    xhr.req.on("error", function() {
+        net.failed++;
+        if (xhr.onerror) xhr.onerror({});
+    });
+    xhr.req.end(body);
+};
+
+var sandbox = {
+    console: console,
+    window: { localStorage: localStorage },
+    XMLHttpRequest: endpoint ? HttpXHR : FakeXHR,
+    setTimeout: endpoint ?
+        function(fn, ms) { return setTimeout(fn, ms / speed); } : setVirtualTimeout,
+    clearTimeout: endpoint ? clearTimeout : clearVirtualTimeout,
+    Pebble: {
+        addEventListener: function(name, fn) {
+            (listeners[name] = listeners[name] || []).push(fn);
+        },
+        getAccountToken: function() { return "host"; },
+        sendAppMessage: function() {},
+        openURL: function() {}
+    }
+};
+sandbox.localStorage = localStorage;
+
+var appPath = appArg ||
+    path.join(__dirname, "..", "..", "src", "js", "pebble-js-app.js");
+var context = vm.createContext(sandbox);
+vm.runInContext(fs.readFileSync(appPath, "utf8"), context, { filename: appPath });
+if (format) {
+    vm.runInContext("strap_api_accl_format = " + JSON.stringify(format), context);
+}
+
+var fire = function(name, e) {
+    (listeners[name] || []).forEach(function(fn) { fn(e); });
+};
+
+var queued = function() {
+    var index = vm.runInContext("strap_api_upq.index", context);
+    return index ? index.last - index.first : 0;
+};
+
+var lines = fs.readFileSync(dumpPath, "utf8").split("\n").filter(Boolean)
+    .map(function(line) { return JSON.parse(line); });
+var handlerMs = 0, handlerMaxMs = 0, maxQueued = 0;
+var deliver = function(msg) {
+    var start = process.hrtime();
+    fire("appmessage", { payload: msg.payload });
+    var t = process.hrtime(start);
+    var ms = t[0] * 1e3 + t[1] / 1e6;
+    handlerMs += ms;
+    handlerMaxMs = Math.max(handlerMaxMs, ms);
+    maxQueued = Math.max(maxQueued, queued());
+};
+
+fire("ready", {});
+if (endpoint) {
+    // messages at their times, sped up, then wait for the queue to empty
+    lines.forEach(function(msg) {
+        setTimeout(function() { deliver(msg); }, (msg.t || 0) / speed);
+    });
+    var last = lines.length ? lines[lines.length - 1].t : 0;
+    setTimeout(function wait() {
+        if (queued()) {
+            setTimeout(wait, 100);
+        } else {
+            process.exit(report() ? 0 : 1);
+        }
+    }, last / speed + 100);
+} else {
+    lines.forEach(function(msg) {
+        runUntil(msg.t || now);     // frames from bench_codec have no times
+        deliver(msg);
+    });
+    // the idle flush, then retries until the queue is empty or a day has gone
+    var end = now + 24 * 3600 * 1000;
+    while (Object.keys(timers).length && now < end) {
+        runUntil(Math.min(end, Math.min.apply(null,
+            Object.keys(timers).map(function(id) { return timers[id].at; }))));
+    }
+    process.exitCode = report() ? 0 : 1;
+}
+
+// false when the counts posted are not those expected
+function report() {
+    var samples = [];
+    var actions = 0;
+    var acclBytes = 0;
+    var windows = 0, featBytes = 0;
+    var rates = {};     // samples posted at each rate the watch reported
+    posts.forEach(function(p) {
+        var q = upload.parseForm(p.body);
+        var readings = upload.decodeUpload(q);
+        var feat = upload.decodeFeatures(q);
+        if (feat) {
+            windows += feat.length;
+            featBytes += p.body.length;
+        } else if (readings) {
+            samples = samples.concat(readings);
+            acclBytes += p.body.length;
+            var hz = q.hz ? q.hz + " Hz" : "unknown";
+            rates[hz] = (rates[hz] || 0) + readings.length;
+        } else {
+            actions += q.count ? parseInt(q.count) : 1;
+        }
+    });
+
+    console.log("messages:       " + lines.length);
+    console.log("posts:          " + posts.length + " (" + actions + " events)");
+    console.log("samples posted: " + samples.length);
+    console.log("accel uploads:  " + acclBytes + " bytes, " +
+        (samples.length ? acclBytes / samples.length : 0).toFixed(2) +
+        " per sample");
+    console.log("sampling rates: " + Object.keys(rates).map(function(hz) {
+        return rates[hz] + " at " + hz;
+    }).join(", "));
+    if (windows) {
+        console.log("feature windows: " + windows + ", " + featBytes + " bytes, " +
+            (featBytes / windows).toFixed(2) + " per window");
+    }
+    console.log("requests:       " + net.attempts + " sent, " + net.failed +
+        " failed, " + net.aborted + " timed out, " + queued() +
+        " left queued (most " + maxQueued + ")");
+    console.log("handler:        " + (handlerMs / lines.length).toFixed(3) +
+        " ms mean, " + handlerMaxMs.toFixed(3) + " ms max per message");
+    console.log("localStorage:   " + storage.writes + " writes, " +
+        storage.written + " chars written, " + storage.read + " chars read");
+
+    if (samplesPath) {
+        fs.writeFileSync(samplesPath, samples.map(function(s) {
+            return [s.ts, s.x, s.y, s.z, s.vib ? 1 : 0].join(",");
+        }).join("\n") + "\n");
+    }
+
+    var ok = true;
+    if (expectSamples !== null && samples.length != parseInt(expectSamples)) {
+        console.error("expected " + expectSamples + " samples, posted " +
+            samples.length);
+        ok = false;
+    }
+    if (expectWindows !== null && windows != parseInt(expectWindows)) {
+        console.error("expected " + expectWindows + " feature windows, posted " +
+            windows);
+        ok = false;
+    }
+    return ok;
+}
@@ -0,0 +1,91 @@
+// ==========================================================================
+// endpoint.js
+//
+// Local stand-in for the Strap upload endpoint. Takes the form posts that
+// pebble-js-app.js makes, decodes accel uploads in either format with
+// upload_decode.js, and answers 400 to anything it cannot decode:
+//
+//   node tools/host/endpoint.js [port] [--samples out.csv] [--fail permille]
+//       [--drop permille] [--latency ms]
+//   node tools/host/companion.js dump.jsonl --format col1 \
+//       --endpoint http://localhost:8080/create/visit/with/
+//
+// --fail turns away that many posts in a thousand with a 503 and --drop
+// closes the connection on them, both before they are counted, and
+// --latency holds every answer back. On Ctrl-C it prints what it received.
+// ==========================================================================
+var http = require("http");
+var fs = require("fs");
+var upload = require("./upload_decode");
+
+var args = process.argv.slice(2);
+var port = args[0] && args[0][0] != "-" ? parseInt(args[0]) : 8080;
+var arg = function(name, dflt) {
+    return args.indexOf(name) >= 0 ? args[args.indexOf(name) + 1] : dflt;
+};
+var samplesPath = arg("--samples", null);
+var failPermille = parseInt(arg("--fail", "0"));
+var dropPermille = parseInt(arg("--drop", "0"));
+var latencyMs = parseInt(arg("--latency", "0"));
+
+var stats = { posts: 0, events: 0, uploads: 0, samples: 0, windows: 0,
+    bytes: 0, bad: 0, failed: 0, dropped: 0 };
+var samples = [];
+
+http.createServer(function(req, res) {
+    var body = "";
+    req.on("data", function(c) { body += c; });
+    req.on("end", function() {
+        var roll = Math.random() * 1000;
+        if (roll < dropPermille) {
+            stats.dropped++;
+            req.socket.destroy();
+            return;
+        }
+        if (roll < dropPermille + failPermille) {
+            stats.failed++;
+            setTimeout(function() {
+                res.writeHead(503);
+                res.end();
+            }, latencyMs);
+            return;
+        }
+        stats.posts++;
+        stats.bytes += body.length;
+        try {
+            var q = upload.parseForm(body);
+            var readings = upload.decodeUpload(q);
+            var feat = upload.decodeFeatures(q);
+            if (feat) {
+                stats.uploads++;
+                stats.windows += feat.length;
+            } else if (readings) {
+                stats.uploads++;
+                stats.samples += readings.length;
+                if (samplesPath) samples = samples.concat(readings);
+            } else if (q.action_url) {
+                stats.events += q.count ? parseInt(q.count) : 1;
+            } else {
+                throw new Error("no action_url");
+            }
+            res.writeHead(200);
+        } catch (e) {
+            stats.bad++;
+            console.error("bad post: " + e.message);
+            res.writeHead(400);
+        }
+        setTimeout(function() { res.end(); }, latencyMs);
+    });
+}).listen(port, function() {
+    console.log("listening on " + port);
+});
+
+process.on("SIGINT", function() {
+    console.log(JSON.stringify(stats));
+    if (samplesPath) {
+        fs.writeFileSync(samplesPath, samples.map(function(s) {
+            return [s.ts, s.x, s.y, s.z, s.vib ? 1 : 0].join(",");
+        }).join("\n") + "\n");
+    }
+    process.exit(0);
+});
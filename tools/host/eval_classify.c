@@ -0,0 +1,280 @@
+/* ========================================================================== */
+/* File: eval_classify.c
+ *
+ * Runs a labeled trace through the feature kernel and the classifier in
+ * src/strap and reports how often each window is labeled right, with the
+ * confusion matrix and the cost of classifying a window.
+ *
+ * Usage:
+ *
+ *   eval_classify [--trace file.csv | --synth kind] [--vary seed]
+ *                 [--rate hz] [--seconds n] [--features out.csv]
+ *
+ * Trace labels are those of the synthetic traces: 1 still, 2 walk, 3 run,
+ * 4 cycle. A window takes the label most of its samples have. --vary
+ * changes the cadence, the strength and the wrist orientation of every
+ * minute of a synthetic trace, so the classifier is not only tried on the
+ * exact signals its thresholds were read from. --features writes each
+ * window's classifier inputs and label, for fitting the thresholds.
+ */
+/* ========================================================================== */
+#define PEBBLE_SHIM_IMPL // host malloc and clock, this is not app code
+
+#include <pebble.h>
+#include <math.h>
+#include <time.h>
+
+#include "../../src/strap/feature.h"
+#include "../../src/strap/classify.h"
+#include "shim.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#endif
+
+#define REPEATS 1000
+#define SYNTH_SECONDS 120
+
+typedef struct {
+	ShimSample *samples;
+	uint32_t len;
+	double mean[3];
+} Kind;
+
+static uint32_t window_first;
+static uint32_t stride = 1;      // samples averaged into one by the kernel
+static uint32_t confusion[2][CLASSIFY_CLASSES][CLASSIFY_CLASSES];
+static uint8_t *labels;
+static FILE *features_out;
+static double classify_ns, classify_cycles;
+static uint32_t windows;
+
+static uint32_t rng = 1;
+static double uniform(double lo, double hi) {
+	rng = rng * 1103515245 + 12345;
+	return lo + (hi - lo) * ((rng >> 8) & 0xffff) / 65535.0;
+}
+
+// the label most of the window's samples have
+static uint8_t window_label(uint32_t first, uint32_t n) {
+	uint32_t votes[CLASSIFY_CLASSES] = { 0 };
+	for (uint32_t i = first; i < first + n; i++) {
+		votes[labels[i] < CLASSIFY_CLASSES ? labels[i] : 0]++;
+	}
+	uint8_t best = 0;
+	for (uint8_t c = 1; c < CLASSIFY_CLASSES; c++) {
+		if (votes[c] > votes[best]) {
+			best = c;
+		}
+	}
+	return best;
+}
+
+static void on_window(const FeatureWindow *w) {
+	uint8_t label = window_label(window_first, w->count * stride);
+	window_first += w->count * stride;
+
+	struct timespec t0, t1;
+	uint8_t raw = 0;
+#ifdef HAVE_RDTSC
+	uint64_t c0 = __rdtsc();
+#endif
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (int i = 0; i < REPEATS; i++) {
+		raw = classify_window(w);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+#ifdef HAVE_RDTSC
+	classify_cycles += (double)(__rdtsc() - c0) / REPEATS;
+#endif
+	classify_ns += ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec))
+		/ REPEATS;
+
+	uint8_t held = classify_update(w);
+	confusion[0][label][raw]++;
+	confusion[1][label][held]++;
+	windows++;
+
+	if (features_out) {
+		int16_t f[CLASSIFY_FEATURES];
+		classify_features(w, f);
+		for (int i = 0; i < CLASSIFY_FEATURES; i++) {
+			fprintf(features_out, "%d,", f[i]);
+		}
+		fprintf(features_out, "%u,%u\n", label, raw);
+	}
+}
+
+// one pure trace of each kind, to cut varied minutes from
+static void load_kinds(Kind *kinds) {
+	static const char *names[] = { "still", "walk", "run", "cycle" };
+	for (int k = 0; k < 4; k++) {
+		kinds[k].len = shim_synth_trace(names[k], SYNTH_SECONDS, 1,
+			&kinds[k].samples);
+		memset(kinds[k].mean, 0, sizeof(kinds[k].mean));
+		for (uint32_t i = 0; i < kinds[k].len; i++) {
+			kinds[k].mean[0] += (double)kinds[k].samples[i].x / kinds[k].len;
+			kinds[k].mean[1] += (double)kinds[k].samples[i].y / kinds[k].len;
+			kinds[k].mean[2] += (double)kinds[k].samples[i].z / kinds[k].len;
+		}
+	}
+}
+
+// a mixed trace where every minute has its own cadence, strength and
+// orientation of the wrist about the vertical
+static AccelData *vary(uint32_t seconds, uint32_t rate, uint32_t *out_n) {
+	Kind kinds[4];
+	load_kinds(kinds);
+	uint32_t n = seconds * rate;
+	AccelData *samples = malloc(n * sizeof(*samples));
+	labels = malloc(n);
+
+	double tempo = 1, strength = 1, angle = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		uint32_t t = (uint64_t)i * 1000 / rate;
+		int k = (t / 60000) % 4;
+		if (t % 60000 < 1000 / rate) {
+			tempo = uniform(0.85, 1.15);
+			strength = uniform(0.7, 1.3);
+			angle = uniform(0, 2 * M_PI);
+		}
+		Kind *kind = &kinds[k];
+		uint32_t j = (uint32_t)((t % 60000) * tempo / 10) % kind->len;
+		const ShimSample *s = &kind->samples[j];
+		double v[3] = { s->x, s->y, s->z };
+		for (int a = 0; a < 3; a++) {
+			v[a] = kind->mean[a] + (v[a] - kind->mean[a]) * strength;
+		}
+		double x = v[0] * cos(angle) - v[1] * sin(angle);
+		double y = v[0] * sin(angle) + v[1] * cos(angle);
+		samples[i] = (AccelData) {
+			.x = lround(x), .y = lround(y), .z = lround(v[2]),
+			.timestamp = 1402819200000ull + t,
+		};
+		labels[i] = k + 1;
+	}
+	for (int k = 0; k < 4; k++) {
+		free(kinds[k].samples);
+	}
+	*out_n = n;
+	return samples;
+}
+
+static AccelData *resample(const ShimSample *trace, uint32_t len,
+		uint32_t rate, uint32_t *out_n) {
+	uint32_t span = trace[len - 1].t_ms + 1;
+	uint32_t n = (uint64_t)span * rate / 1000;
+	AccelData *samples = malloc(n * sizeof(*samples));
+	labels = malloc(n);
+	uint32_t j = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		uint32_t t = (uint64_t)i * 1000 / rate;
+		while (j + 1 < len && trace[j + 1].t_ms <= t) {
+			j++;
+		}
+		samples[i] = (AccelData) {
+			.x = trace[j].x, .y = trace[j].y, .z = trace[j].z,
+			.timestamp = 1402819200000ull + t,
+		};
+		labels[i] = trace[j].label;
+	}
+	*out_n = n;
+	return samples;
+}
+
+static void report(const char *title, uint32_t m[CLASSIFY_CLASSES][CLASSIFY_CLASSES]) {
+	uint32_t right = 0, total = 0;
+	printf("\n%s\n%-10s", title, "label");
+	for (int c = 0; c < CLASSIFY_CLASSES; c++) {
+		printf(" %8s", classify_name(c));
+	}
+	printf("\n");
+	for (int l = 0; l < CLASSIFY_CLASSES; l++) {
+		uint32_t row = 0;
+		for (int c = 0; c < CLASSIFY_CLASSES; c++) {
+			row += m[l][c];
+		}
+		if (!row) {
+			continue;
+		}
+		printf("%-10s", classify_name(l));
+		for (int c = 0; c < CLASSIFY_CLASSES; c++) {
+			printf(" %8u", m[l][c]);
+		}
+		printf("   %5.1f%%\n", 100.0 * m[l][l] / row);
+		right += m[l][l];
+		total += row;
+	}
+	printf("accuracy: %u of %u windows, %.1f%%\n", right, total,
+		total ? 100.0 * right / total : 0);
+}
+
+int main(int argc, char **argv) {
+	const char *trace_path = NULL, *synth = "mixed", *features_path = NULL;
+	uint32_t rate = 10, seconds = 3600, seed = 0;
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (!strcmp(argv[i], "--trace")) {
+			trace_path = argv[i + 1];
+		} else if (!strcmp(argv[i], "--synth")) {
+			synth = argv[i + 1];
+		} else if (!strcmp(argv[i], "--vary")) {
+			seed = atoi(argv[i + 1]);
+		} else if (!strcmp(argv[i], "--rate")) {
+			rate = atoi(argv[i + 1]);
+		} else if (!strcmp(argv[i], "--seconds")) {
+			seconds = atoi(argv[i + 1]);
+		} else if (!strcmp(argv[i], "--features")) {
+			features_path = argv[i + 1];
+		}
+	}
+
+	uint32_t n = 0;
+	AccelData *samples;
+	if (seed && !trace_path) {
+		rng = seed;
+		samples = vary(seconds, rate, &n);
+	} else {
+		ShimSample *trace = NULL;
+		uint32_t len = trace_path ? shim_load_trace(trace_path, &trace)
+			: shim_synth_trace(synth, seconds, 1, &trace);
+		if (!len || !rate) {
+			fprintf(stderr, "nothing to classify\n");
+			return 1;
+		}
+		samples = resample(trace, len, rate, &n);
+		free(trace);
+	}
+	if (features_path) {
+		features_out = fopen(features_path, "w");
+		fprintf(features_out, "mag_std,dom_band,dom_amp,crossings,tilt,label,class\n");
+	}
+
+	feature_init(on_window);
+	feature_set_rate(rate);
+	stride = rate * FEATURE_WINDOW_MS / 1000 / feature_window();
+	classify_reset();
+	for (uint32_t i = 0; i < n; i += 10) {
+		feature_add(samples + i, n - i < 10 ? n - i : 10);
+	}
+
+	printf("%u samples at %u Hz, %u windows of %u\n", n, rate, windows,
+		feature_window());
+	printf("classify: %.1f ns/window", windows ? classify_ns / windows : 0);
+#ifdef HAVE_RDTSC
+	printf(" (%.0f cycles)", windows ? classify_cycles / windows : 0);
+#endif
+	printf("\n");
+	report("each window on its own", confusion[0]);
+	char held[64];
+	snprintf(held, sizeof(held), "held for %d windows, as sent", CLASSIFY_HOLD);
+	report(held, confusion[1]);
+
+	if (features_out) {
+		fclose(features_out);
+	}
+	free(samples);
+	free(labels);
+	return 0;
+}
@@ -0,0 +1,485 @@
+/* ========================================================================== */
+/* File: pebble.h (host shim)
+ *
+ * Stand-in for the Pebble SDK header so the watch sources can be compiled
+ * and run on a plain host. Only the API surface used by src/ is declared.
+ * Everything here is backed by pebble_shim.c, which runs a deterministic
+ * simulated clock instead of the real event loop.
+ */
+/* ========================================================================== */
+#ifndef PEBBLE_SHIM_H
+#define PEBBLE_SHIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// ---------------- General
+
+#define ARRAY_LENGTH(array) (sizeof((array))/sizeof((array)[0]))
+
+typedef int32_t status_t;
+#define S_SUCCESS 0
+#define E_DOES_NOT_EXIST -4
+#define E_OUT_OF_STORAGE -8
+
+void psleep(int millis);
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms);
+
+// ---------------- Math
+
+#define TRIG_MAX_RATIO 0xffff
+#define TRIG_MAX_ANGLE 0x10000
+
+int32_t sin_lookup(int32_t angle);
+int32_t cos_lookup(int32_t angle);
+
+// ---------------- Logging
+
+typedef enum {
+	APP_LOG_LEVEL_ERROR = 1,
+	APP_LOG_LEVEL_WARNING = 50,
+	APP_LOG_LEVEL_INFO = 100,
+	APP_LOG_LEVEL_DEBUG = 200,
+	APP_LOG_LEVEL_DEBUG_VERBOSE = 255,
+} AppLogLevel;
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number,
+	const char *fmt, ...) __attribute__((format(printf, 4, 5)));
+
+#define APP_LOG(level, fmt, args...) \
+	app_log(level, __FILE__, __LINE__, fmt, ## args)
+
+// ---------------- Dictionary
+
+typedef enum {
+	TUPLE_BYTE_ARRAY = 0,
+	TUPLE_CSTRING = 1,
+	TUPLE_UINT = 2,
+	TUPLE_INT = 3,
+} TupleType;
+
+typedef struct __attribute__((__packed__)) {
+	uint32_t key;
+	uint8_t type;
+	uint16_t length;
+	union {
+		uint8_t data[0];
+		char cstring[0];
+		uint8_t uint8;
+		uint16_t uint16;
+		uint32_t uint32;
+		int8_t int8;
+		int16_t int16;
+		int32_t int32;
+	} value[];
+} Tuple;
+
+typedef struct __attribute__((__packed__)) {
+	uint8_t count;
+	Tuple head[];
+} Dictionary;
+
+typedef struct {
+	Dictionary *dictionary;
+	const void *end;
+	Tuple *cursor;
+} DictionaryIterator;
+
+typedef enum {
+	DICT_OK = 0,
+	DICT_NOT_ENOUGH_STORAGE = 1 << 1,
+	DICT_INVALID_ARGS = 1 << 2,
+	DICT_INTERNAL_INCONSISTENCY = 1 << 3,
+	DICT_MALLOC_FAILED = 1 << 4,
+} DictionaryResult;
+
+typedef struct Tuplet {
+	TupleType type;
+	uint32_t key;
+	union {
+		struct {
+			const uint8_t *data;
+			uint16_t length;
+		} bytes;
+		struct {
+			const char *data;
+			uint16_t length;
+		} cstring;
+		struct {
+			uint32_t storage;
+			uint16_t width;
+		} integer;
+	};
+} Tuplet;
+
+#define TUPLE_HEADER_SIZE 7
+#define DICT_HEADER_SIZE 1
+
+#define TupletBytes(_key, _data, _length) \
+((const Tuplet) { .type = TUPLE_BYTE_ARRAY, .key = _key, .bytes = { .data = _data, .length = _length }})
+
+#define TupletCString(_key, _cstring) \
+((const Tuplet) { .type = TUPLE_CSTRING, .key = _key, .cstring = { .data = _cstring, .length = _cstring ? strlen(_cstring) + 1 : 0 }})
+
+#define TupletInteger(_key, _integer) \
+((const Tuplet) { .type = ((__typeof__(_integer))-1 < 0) ? TUPLE_INT : TUPLE_UINT, .key = _key, .integer = { .storage = (uint32_t)(_integer), .width = sizeof(_integer) }})
+
+uint32_t dict_calc_buffer_size(const uint8_t tuple_count, ...);
+DictionaryResult dict_write_begin(DictionaryIterator *iter, uint8_t *buffer,
+	const uint16_t size);
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key,
+	const uint8_t *data, const uint16_t size);
+DictionaryResult dict_write_cstring(DictionaryIterator *iter,
+	const uint32_t key, const char *cstring);
+DictionaryResult dict_write_int(DictionaryIterator *iter, const uint32_t key,
+	const void *integer, const uint8_t width_bytes, const bool is_signed);
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key,
+	const uint8_t value);
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key,
+	const int32_t value);
+DictionaryResult dict_write_tuplet(DictionaryIterator *iter,
+	const Tuplet * const tuplet);
+uint32_t dict_write_end(DictionaryIterator *iter);
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter,
+	const uint8_t * const buffer, const uint16_t size);
+Tuple *dict_read_first(DictionaryIterator *iter);
+Tuple *dict_read_next(DictionaryIterator *iter);
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key);
+
+// ---------------- AppMessage
+
+typedef enum {
+	APP_MSG_OK = 0,
+	APP_MSG_SEND_TIMEOUT = 1 << 1,
+	APP_MSG_SEND_REJECTED = 1 << 2,
+	APP_MSG_NOT_CONNECTED = 1 << 3,
+	APP_MSG_APP_NOT_RUNNING = 1 << 4,
+	APP_MSG_INVALID_ARGS = 1 << 5,
+	APP_MSG_BUSY = 1 << 6,
+	APP_MSG_BUFFER_OVERFLOW = 1 << 7,
+	APP_MSG_ALREADY_RELEASED = 1 << 9,
+	APP_MSG_CALLBACK_ALREADY_REGISTERED = 1 << 10,
+	APP_MSG_CALLBACK_NOT_REGISTERED = 1 << 11,
+	APP_MSG_OUT_OF_MEMORY = 1 << 12,
+	APP_MSG_CLOSED = 1 << 13,
+	APP_MSG_INTERNAL_ERROR = 1 << 14,
+} AppMessageResult;
+
+#define APP_MESSAGE_INBOX_SIZE_MINIMUM 124
+#define APP_MESSAGE_OUTBOX_SIZE_MINIMUM 636
+
+typedef void (*AppMessageInboxReceived)(DictionaryIterator *iterator,
+	void *context);
+typedef void (*AppMessageInboxDropped)(AppMessageResult reason,
+	void *context);
+typedef void (*AppMessageOutboxSent)(DictionaryIterator *iterator,
+	void *context);
+typedef void (*AppMessageOutboxFailed)(DictionaryIterator *iterator,
+	AppMessageResult reason, void *context);
+
+uint32_t app_message_inbox_size_maximum(void);
+uint32_t app_message_outbox_size_maximum(void);
+AppMessageResult app_message_open(const uint32_t size_inbound,
+	const uint32_t size_outbound);
+void app_message_deregister_callbacks(void);
+void *app_message_get_context(void);
+void *app_message_set_context(void *context);
+AppMessageInboxReceived app_message_register_inbox_received(
+	AppMessageInboxReceived received_callback);
+AppMessageInboxDropped app_message_register_inbox_dropped(
+	AppMessageInboxDropped dropped_callback);
+AppMessageOutboxSent app_message_register_outbox_sent(
+	AppMessageOutboxSent sent_callback);
+AppMessageOutboxFailed app_message_register_outbox_failed(
+	AppMessageOutboxFailed failed_callback);
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator);
+AppMessageResult app_message_outbox_send(void);
+
+typedef enum {
+	SNIFF_INTERVAL_NORMAL = 0,
+	SNIFF_INTERVAL_REDUCED = 1,
+} SniffInterval;
+
+void app_comm_set_sniff_interval(const SniffInterval interval);
+
+// ---------------- Timers
+
+struct AppTimer;
+typedef struct AppTimer AppTimer;
+typedef void (*AppTimerCallback)(void *data);
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback,
+	void *callback_data);
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms);
+void app_timer_cancel(AppTimer *timer_handle);
+
+// ---------------- Services
+
+typedef enum {
+	SECOND_UNIT = 1 << 0,
+	MINUTE_UNIT = 1 << 1,
+	HOUR_UNIT = 1 << 2,
+	DAY_UNIT = 1 << 3,
+	MONTH_UNIT = 1 << 4,
+	YEAR_UNIT = 1 << 5,
+} TimeUnits;
+
+typedef void (*TickHandler)(struct tm *tick_time, TimeUnits units_changed);
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler);
+void tick_timer_service_unsubscribe(void);
+
+typedef struct {
+	int16_t x;
+	int16_t y;
+	int16_t z;
+	bool did_vibrate;
+	uint64_t timestamp;
+} AccelData;
+
+typedef enum {
+	ACCEL_AXIS_X = 0,
+	ACCEL_AXIS_Y = 1,
+	ACCEL_AXIS_Z = 2,
+} AccelAxisType;
+
+typedef enum {
+	ACCEL_SAMPLING_10HZ = 10,
+	ACCEL_SAMPLING_25HZ = 25,
+	ACCEL_SAMPLING_50HZ = 50,
+	ACCEL_SAMPLING_100HZ = 100,
+} AccelSamplingRate;
+
+typedef void (*AccelDataHandler)(AccelData *data, uint32_t num_samples);
+typedef void (*AccelTapHandler)(AccelAxisType axis, int32_t direction);
+
+void accel_data_service_subscribe(uint32_t samples_per_update,
+	AccelDataHandler handler);
+void accel_data_service_unsubscribe(void);
+int accel_service_set_sampling_rate(AccelSamplingRate rate);
+int accel_service_set_samples_per_update(uint32_t num_samples);
+int accel_service_peek(AccelData *data);
+void accel_tap_service_subscribe(AccelTapHandler handler);
+void accel_tap_service_unsubscribe(void);
+
+typedef struct {
+	uint8_t charge_percent;
+	bool is_charging;
+	bool is_plugged;
+} BatteryChargeState;
+
+BatteryChargeState battery_state_service_peek(void);
+
+typedef void (*BluetoothConnectionHandler)(bool connected);
+bool bluetooth_connection_service_peek(void);
+void bluetooth_connection_service_subscribe(
+	BluetoothConnectionHandler handler);
+void bluetooth_connection_service_unsubscribe(void);
+
+// ---------------- Persistent storage
+
+#define PERSIST_DATA_MAX_LENGTH 256
+#define PERSIST_STRING_MAX_LENGTH PERSIST_DATA_MAX_LENGTH
+
+bool persist_exists(const uint32_t key);
+int persist_get_size(const uint32_t key);
+int32_t persist_read_int(const uint32_t key);
+int persist_read_data(const uint32_t key, void *buffer,
+	const size_t buffer_size);
+int persist_read_string(const uint32_t key, char *buffer,
+	const size_t buffer_size);
+status_t persist_write_int(const uint32_t key, const int32_t value);
+int persist_write_data(const uint32_t key, const void *data,
+	const size_t size);
+int persist_write_string(const uint32_t key, const char *cstring);
+status_t persist_delete(const uint32_t key);
+
+// ---------------- Vibes
+
+typedef struct {
+	const uint32_t *durations;
+	uint32_t num_segments;
+} VibePattern;
+
+void vibes_enqueue_custom_pattern(VibePattern pattern);
+void vibes_short_pulse(void);
+void vibes_long_pulse(void);
+void vibes_double_pulse(void);
+void vibes_cancel(void);
+
+// ---------------- Graphics
+
+typedef struct GPoint {
+	int16_t x;
+	int16_t y;
+} GPoint;
+
+typedef struct GSize {
+	int16_t w;
+	int16_t h;
+} GSize;
+
+typedef struct GRect {
+	GPoint origin;
+	GSize size;
+} GRect;
+
+#define GPoint(x, y) ((GPoint){(x), (y)})
+#define GSize(w, h) ((GSize){(w), (h)})
+#define GRect(x, y, w, h) ((GRect){{(x), (y)}, {(w), (h)}})
+
+typedef enum {
+	GColorClear = ~0,
+	GColorBlack = 0,
+	GColorWhite = 1,
+} GColor;
+
+typedef enum {
+	GTextAlignmentLeft,
+	GTextAlignmentCenter,
+	GTextAlignmentRight,
+} GTextAlignment;
+
+typedef enum {
+	GTextOverflowModeWordWrap,
+	GTextOverflowModeTrailingEllipsis,
+	GTextOverflowModeFill,
+} GTextOverflowMode;
+
+typedef enum {
+	GCornerNone = 0,
+} GCornerMask;
+
+typedef struct GContext GContext;
+typedef const char *GFont;
+typedef void *GTextLayoutCacheRef;
+
+#define FONT_KEY_GOTHIC_14 "RESOURCE_ID_GOTHIC_14"
+#define FONT_KEY_GOTHIC_14_BOLD "RESOURCE_ID_GOTHIC_14_BOLD"
+#define FONT_KEY_GOTHIC_18 "RESOURCE_ID_GOTHIC_18"
+#define FONT_KEY_GOTHIC_18_BOLD "RESOURCE_ID_GOTHIC_18_BOLD"
+#define FONT_KEY_GOTHIC_24_BOLD "RESOURCE_ID_GOTHIC_24_BOLD"
+#define FONT_KEY_BITHAM_42_BOLD "RESOURCE_ID_BITHAM_42_BOLD"
+#define FONT_KEY_BITHAM_42_MEDIUM_NUMBERS "RESOURCE_ID_BITHAM_42_MEDIUM_NUMBERS"
+
+GFont fonts_get_system_font(const char *font_key);
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color);
+void graphics_context_set_stroke_color(GContext *ctx, GColor color);
+void graphics_context_set_text_color(GContext *ctx, GColor color);
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius,
+	GCornerMask corner_mask);
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1);
+void graphics_draw_text(GContext *ctx, const char *text, const GFont font,
+	const GRect box, const GTextOverflowMode overflow_mode,
+	const GTextAlignment alignment,
+	const GTextLayoutCacheRef layout);
+
+typedef struct Layer Layer;
+typedef void (*LayerUpdateProc)(struct Layer *layer, GContext *ctx);
+
+Layer *layer_create(GRect frame);
+Layer *layer_create_with_data(GRect frame, size_t data_size);
+void *layer_get_data(const Layer *layer);
+void layer_destroy(Layer *layer);
+void layer_mark_dirty(Layer *layer);
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc);
+void layer_set_frame(Layer *layer, GRect frame);
+GRect layer_get_frame(const Layer *layer);
+GRect layer_get_bounds(const Layer *layer);
+void layer_add_child(Layer *parent, Layer *child);
+void layer_remove_from_parent(Layer *child);
+void layer_set_hidden(Layer *layer, bool hidden);
+bool layer_get_hidden(const Layer *layer);
+
+typedef struct TextLayer TextLayer;
+
+TextLayer *text_layer_create(GRect frame);
+void text_layer_destroy(TextLayer *text_layer);
+Layer *text_layer_get_layer(TextLayer *text_layer);
+void text_layer_set_text(TextLayer *text_layer, const char *text);
+const char *text_layer_get_text(TextLayer *text_layer);
+void text_layer_set_background_color(TextLayer *text_layer, GColor color);
+void text_layer_set_text_color(TextLayer *text_layer, GColor color);
+void text_layer_set_font(TextLayer *text_layer, GFont font);
+void text_layer_set_text_alignment(TextLayer *text_layer,
+	GTextAlignment text_alignment);
+void text_layer_set_size(TextLayer *text_layer, const GSize max_size);
+
+typedef struct Window Window;
+typedef void (*WindowHandler)(struct Window *window);
+
+typedef struct WindowHandlers {
+	WindowHandler load;
+	WindowHandler appear;
+	WindowHandler disappear;
+	WindowHandler unload;
+} WindowHandlers;
+
+Window *window_create(void);
+void window_destroy(Window *window);
+void window_set_window_handlers(Window *window, WindowHandlers handlers);
+void window_set_background_color(Window *window, GColor background_color);
+Layer *window_get_root_layer(const Window *window);
+void window_stack_push(Window *window, bool animated);
+Window *window_stack_pop(bool animated);
+Window *window_stack_remove(Window *window, bool animated);
+bool window_stack_contains_window(Window *window);
+
+// ---------------- Animation
+
+#define ANIMATION_NORMALIZED_MIN 0
+#define ANIMATION_NORMALIZED_MAX 65535
+
+struct Animation;
+typedef struct Animation Animation;
+
+typedef void (*AnimationSetupImplementation)(struct Animation *animation);
+typedef void (*AnimationUpdateImplementation)(struct Animation *animation,
+	const uint32_t time_normalized);
+typedef void (*AnimationTeardownImplementation)(struct Animation *animation);
+
+typedef struct AnimationImplementation {
+	AnimationSetupImplementation setup;
+	AnimationUpdateImplementation update;
+	AnimationTeardownImplementation teardown;
+} AnimationImplementation;
+
+Animation *animation_create(void);
+void animation_destroy(Animation *animation);
+void animation_set_duration(Animation *animation, uint32_t duration_ms);
+void animation_set_implementation(Animation *animation,
+	const AnimationImplementation *implementation);
+void animation_schedule(Animation *animation);
+void animation_unschedule(Animation *animation);
+bool animation_is_scheduled(Animation *animation);
+
+// ---------------- App lifecycle
+
+void app_event_loop(void);
+
+// ---------------- Simulated clock and heap
+//
+// The watch sources see the simulated clock through time() and the tracked
+// app heap through malloc()/calloc()/free(). The shim itself is compiled with
+// PEBBLE_SHIM_IMPL so it can still reach the host versions.
+
+time_t shim_time(time_t *tloc);
+void *shim_malloc(size_t size) __attribute__((malloc, alloc_size(1)));
+void *shim_calloc(size_t count, size_t size)
+	__attribute__((malloc, alloc_size(1, 2)));
+void *shim_realloc(void *ptr, size_t size) __attribute__((alloc_size(2)));
+void shim_free(void *ptr);
+
+#ifndef PEBBLE_SHIM_IMPL
+#define time(tloc) shim_time(tloc)
+#define malloc(size) shim_malloc(size)
+#define calloc(count, size) shim_calloc(count, size)
+#define realloc(ptr, size) shim_realloc(ptr, size)
+#define free(ptr) shim_free(ptr)
+#endif
+
+#endif // PEBBLE_SHIM_H
@@ -0,0 +1,1572 @@
+/* ========================================================================== */
+/* File: pebble_shim.c
+ *
+ * Host implementation of the Pebble SDK calls declared in pebble.h.
+ *
+ * app_event_loop() runs a discrete event simulation: timers, tick service,
+ * accelerometer batches (replayed from a trace), outbox acknowledgements,
+ * animation frames and Bluetooth drop-outs are all ordered on one simulated
+ * millisecond clock, so a run is fully deterministic for a given config.
+ */
+/* ========================================================================== */
+#define PEBBLE_SHIM_IMPL
+
+#include <math.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "pebble.h"
+#include "shim.h"
+
+// ---------------- Constant definitions
+
+#define MAX_TIMERS 256
+#define MAX_PERSIST 128
+#define MAX_ANIMATIONS 4
+#define MAX_WINDOWS 8
+#define PERSIST_TOTAL_MAX 4096
+#define INBOX_MAX 2026
+#define OUTBOX_MAX 656
+#define ANIM_FRAME_MS 33
+#define TAP_THRESHOLD 1200 // mg of jerk between samples counted as a tap
+#define TAP_REFRACTORY_MS 500
+#define NEVER UINT64_MAX
+
+// ---------------- Structures/Types
+
+struct AppTimer {
+	uint64_t due;
+	AppTimerCallback callback;
+	void *data;
+	bool active;
+};
+
+struct Layer {
+	GRect frame;
+	LayerUpdateProc update_proc;
+	struct Layer *parent;
+	struct Layer *next_registered;
+	struct TextLayer *text;
+	void *data;
+	bool hidden;
+	bool dirty;
+};
+
+struct TextLayer {
+	struct Layer layer;
+	const char *text;
+	GColor background;
+};
+
+struct Window {
+	struct Layer root;
+	WindowHandlers handlers;
+	bool loaded;
+};
+
+struct Animation {
+	uint32_t duration;
+	const AnimationImplementation *impl;
+	uint64_t start;
+	uint64_t next_frame;
+	bool scheduled;
+};
+
+struct GContext {
+	GColor fill;
+};
+
+typedef struct {
+	uint32_t key;
+	uint16_t length;
+	uint8_t data[PERSIST_DATA_MAX_LENGTH];
+	bool used;
+} PersistEntry;
+
+// ---------------- Public variables
+
+ShimConfig shim_config = {
+	.duration_s = 600,
+	.ack_latency_ms = 120,
+	.battery_percent = 80,
+};
+ShimStats shim_stats;
+
+// ---------------- Private variables
+
+static uint64_t now_ms;
+static uint32_t rng_state;
+
+static struct AppTimer timers[MAX_TIMERS];
+static uint32_t next_timer_slot;
+
+static TickHandler tick_handler;
+static TimeUnits tick_units;
+static uint64_t next_tick_ms = NEVER;
+
+static AccelDataHandler accel_handler;
+static AccelTapHandler tap_handler;
+static uint32_t accel_batch_size = 25;
+static uint32_t accel_rate = ACCEL_SAMPLING_25HZ;
+static AccelData *accel_batch;
+static uint32_t accel_batch_fill;
+static uint64_t next_sensor_ms = NEVER;
+static AccelData last_sample;
+static bool have_last_sample;
+static uint64_t last_tap_ms;
+static uint64_t vibe_until_ms;
+
+static AppMessageInboxReceived inbox_received;
+static AppMessageOutboxSent outbox_sent;
+static AppMessageOutboxFailed outbox_failed;
+static void *message_context;
+static uint8_t *inbox_buffer;
+static uint8_t *outbox_buffer;
+static uint32_t inbox_size;
+static uint32_t outbox_size;
+static DictionaryIterator outbox_iter;
+static bool outbox_open;
+static bool outbox_in_flight;
+static uint64_t outbox_done_ms = NEVER;
+static AppMessageResult outbox_result;
+static uint32_t next_inbox;
+
+static bool bt_connected = true;
+static BluetoothConnectionHandler bt_handler;
+
+static SniffInterval sniff = SNIFF_INTERVAL_NORMAL;
+static uint64_t sniff_since_ms;
+
+static PersistEntry persist[MAX_PERSIST];
+
+static struct Layer *layers;
+static struct Window *window_stack[MAX_WINDOWS];
+static int window_count;
+static struct Animation *animations[MAX_ANIMATIONS];
+
+// ---------------- Private prototypes
+
+static uint32_t rng_next(void);
+static void count_wakeup(uint64_t started);
+static void render(void);
+static void register_layer(struct Layer *layer, GRect frame);
+static void unregister_layer(struct Layer *layer);
+static PersistEntry *persist_find(uint32_t key);
+static int persist_total(void);
+static void dump_outbox(void);
+
+/* ========================================================================== */
+/* Simulated clock and heap                                                   */
+/* ========================================================================== */
+
+time_t shim_time(time_t *tloc) {
+	time_t t = shim_config.start_time + (time_t)(now_ms / 1000);
+	if (tloc) {
+		*tloc = t;
+	}
+	return t;
+}
+
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms) {
+	uint16_t ms = now_ms % 1000;
+	shim_time(tloc);
+	if (out_ms) {
+		*out_ms = ms;
+	}
+	return ms;
+}
+
+void psleep(int millis) {
+	now_ms += millis;
+}
+
+// the SDK reads these from a table; the nearest value is close enough
+int32_t sin_lookup(int32_t angle) {
+	return lround(sin(2 * M_PI * angle / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+int32_t cos_lookup(int32_t angle) {
+	return lround(cos(2 * M_PI * angle / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+void *shim_malloc(size_t size) {
+	size_t *block = malloc(sizeof(size_t) * 2 + size);
+	if (!block) {
+		return NULL;
+	}
+	block[0] = size;
+	shim_stats.allocs++;
+	shim_stats.heap_now += size;
+	if (shim_stats.heap_now > shim_stats.heap_peak) {
+		shim_stats.heap_peak = shim_stats.heap_now;
+	}
+	return block + 2;
+}
+
+void *shim_calloc(size_t count, size_t size) {
+	void *ptr = shim_malloc(count * size);
+	if (ptr) {
+		memset(ptr, 0, count * size);
+	}
+	return ptr;
+}
+
+void *shim_realloc(void *ptr, size_t size) {
+	if (!ptr) {
+		return shim_malloc(size);
+	}
+	size_t old = ((size_t *)ptr)[-2];
+	void *fresh = shim_malloc(size);
+	if (fresh) {
+		memcpy(fresh, ptr, old < size ? old : size);
+		shim_free(ptr);
+	}
+	return fresh;
+}
+
+void shim_free(void *ptr) {
+	if (!ptr) {
+		return;
+	}
+	size_t *block = (size_t *)ptr - 2;
+	shim_stats.heap_now -= block[0];
+	free(block);
+}
+
+static uint32_t rng_next(void) {
+	rng_state = rng_state * 1103515245u + 12345u;
+	return rng_state >> 8;
+}
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number,
+		const char *fmt, ...) {
+	if (!shim_config.verbose) {
+		return;
+	}
+	va_list args;
+	va_start(args, fmt);
+	fprintf(stderr, "[%8.3f] %s:%d ", now_ms / 1000.0, src_filename,
+		src_line_number);
+	vfprintf(stderr, fmt, args);
+	fputc('\n', stderr);
+	va_end(args);
+}
+
+/* ========================================================================== */
+/* Dictionary                                                                 */
+/* ========================================================================== */
+
+uint32_t dict_calc_buffer_size(const uint8_t tuple_count, ...) {
+	uint32_t total = DICT_HEADER_SIZE + tuple_count * TUPLE_HEADER_SIZE;
+	va_list args;
+	va_start(args, tuple_count);
+	for (int i = 0; i < tuple_count; i++) {
+		total += va_arg(args, uint32_t);
+	}
+	va_end(args);
+	return total;
+}
+
+DictionaryResult dict_write_begin(DictionaryIterator *iter, uint8_t *buffer,
+		const uint16_t size) {
+	if (!iter || !buffer || size < DICT_HEADER_SIZE) {
+		return DICT_INVALID_ARGS;
+	}
+	iter->dictionary = (Dictionary *)buffer;
+	iter->dictionary->count = 0;
+	iter->cursor = iter->dictionary->head;
+	iter->end = buffer + size;
+	return DICT_OK;
+}
+
+static DictionaryResult dict_append(DictionaryIterator *iter, uint32_t key,
+		TupleType type, const void *data, uint16_t length) {
+	if (!iter || !iter->dictionary || !iter->cursor) {
+		return DICT_INVALID_ARGS;
+	}
+	uint8_t *at = (uint8_t *)iter->cursor;
+	if (at + TUPLE_HEADER_SIZE + length > (const uint8_t *)iter->end) {
+		return DICT_NOT_ENOUGH_STORAGE;
+	}
+	Tuple *tuple = iter->cursor;
+	tuple->key = key;
+	tuple->type = type;
+	tuple->length = length;
+	if (length) {
+		memcpy(tuple->value->data, data, length);
+	}
+	iter->cursor = (Tuple *)(at + TUPLE_HEADER_SIZE + length);
+	iter->dictionary->count++;
+	return DICT_OK;
+}
+
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key,
+		const uint8_t *data, const uint16_t size) {
+	return dict_append(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+DictionaryResult dict_write_cstring(DictionaryIterator *iter,
+		const uint32_t key, const char *cstring) {
+	return dict_append(iter, key, TUPLE_CSTRING, cstring,
+		cstring ? strlen(cstring) + 1 : 0);
+}
+
+DictionaryResult dict_write_int(DictionaryIterator *iter, const uint32_t key,
+		const void *integer, const uint8_t width_bytes,
+		const bool is_signed) {
+	if (width_bytes != 1 && width_bytes != 2 && width_bytes != 4) {
+		return DICT_INVALID_ARGS;
+	}
+	return dict_append(iter, key, is_signed ? TUPLE_INT : TUPLE_UINT,
+		integer, width_bytes);
+}
+
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key,
+		const uint8_t value) {
+	return dict_write_int(iter, key, &value, 1, false);
+}
+
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key,
+		const int32_t value) {
+	return dict_write_int(iter, key, &value, 4, true);
+}
+
+DictionaryResult dict_write_tuplet(DictionaryIterator *iter,
+		const Tuplet * const tuplet) {
+	switch (tuplet->type) {
+		case TUPLE_BYTE_ARRAY:
+			return dict_write_data(iter, tuplet->key, tuplet->bytes.data,
+				tuplet->bytes.length);
+		case TUPLE_CSTRING:
+			return dict_append(iter, tuplet->key, TUPLE_CSTRING,
+				tuplet->cstring.data, tuplet->cstring.length);
+		case TUPLE_INT:
+		case TUPLE_UINT: {
+			uint32_t storage = tuplet->integer.storage;
+			return dict_write_int(iter, tuplet->key, &storage,
+				tuplet->integer.width, tuplet->type == TUPLE_INT);
+		}
+	}
+	return DICT_INVALID_ARGS;
+}
+
+uint32_t dict_write_end(DictionaryIterator *iter) {
+	if (!iter || !iter->dictionary || !iter->cursor) {
+		return 0;
+	}
+	uint32_t size = (uint8_t *)iter->cursor - (uint8_t *)iter->dictionary;
+	iter->end = iter->cursor;
+	iter->cursor = iter->dictionary->head;
+	return size;
+}
+
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter,
+		const uint8_t * const buffer, const uint16_t size) {
+	iter->dictionary = (Dictionary *)buffer;
+	iter->end = buffer + size;
+	return dict_read_first(iter);
+}
+
+Tuple *dict_read_first(DictionaryIterator *iter) {
+	iter->cursor = iter->dictionary->head;
+	if (iter->dictionary->count == 0) {
+		return NULL;
+	}
+	return iter->cursor;
+}
+
+Tuple *dict_read_next(DictionaryIterator *iter) {
+	uint8_t *next = (uint8_t *)iter->cursor + TUPLE_HEADER_SIZE
+		+ iter->cursor->length;
+	if (next >= (const uint8_t *)iter->end) {
+		return NULL;
+	}
+	iter->cursor = (Tuple *)next;
+	return iter->cursor;
+}
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key) {
+	DictionaryIterator walk = *iter;
+	for (Tuple *t = dict_read_first(&walk); t; t = dict_read_next(&walk)) {
+		if (t->key == key) {
+			return t;
+		}
+	}
+	return NULL;
+}
+
+// end of the written tuples, whether or not dict_write_end() rewound the
+// cursor for reading
+static uint8_t *dict_written_end(const DictionaryIterator *iter) {
+	if (iter->dictionary->count && iter->cursor == iter->dictionary->head) {
+		return (uint8_t *)iter->end;
+	}
+	return (uint8_t *)iter->cursor;
+}
+
+static uint32_t dict_used(const DictionaryIterator *iter) {
+	if (!iter->dictionary || !iter->cursor) {
+		return 0;
+	}
+	return dict_written_end(iter) - (uint8_t *)iter->dictionary;
+}
+
+/* ========================================================================== */
+/* AppMessage                                                                 */
+/* ========================================================================== */
+
+uint32_t app_message_inbox_size_maximum(void) {
+	return INBOX_MAX;
+}
+
+uint32_t app_message_outbox_size_maximum(void) {
+	return OUTBOX_MAX;
+}
+
+AppMessageResult app_message_open(const uint32_t size_inbound,
+		const uint32_t size_outbound) {
+	if (outbox_open) {
+		return APP_MSG_INVALID_ARGS;
+	}
+	inbox_size = size_inbound > INBOX_MAX ? INBOX_MAX : size_inbound;
+	outbox_size = size_outbound > OUTBOX_MAX ? OUTBOX_MAX : size_outbound;
+	inbox_buffer = shim_malloc(inbox_size);
+	outbox_buffer = shim_malloc(outbox_size);
+	outbox_open = true;
+	return APP_MSG_OK;
+}
+
+void app_message_deregister_callbacks(void) {
+	inbox_received = NULL;
+	outbox_sent = NULL;
+	outbox_failed = NULL;
+}
+
+void *app_message_get_context(void) {
+	return message_context;
+}
+
+void *app_message_set_context(void *context) {
+	void *old = message_context;
+	message_context = context;
+	return old;
+}
+
+AppMessageInboxReceived app_message_register_inbox_received(
+		AppMessageInboxReceived received_callback) {
+	AppMessageInboxReceived old = inbox_received;
+	inbox_received = received_callback;
+	return old;
+}
+
+AppMessageInboxDropped app_message_register_inbox_dropped(
+		AppMessageInboxDropped dropped_callback) {
+	return NULL;
+}
+
+AppMessageOutboxSent app_message_register_outbox_sent(
+		AppMessageOutboxSent sent_callback) {
+	AppMessageOutboxSent old = outbox_sent;
+	outbox_sent = sent_callback;
+	return old;
+}
+
+AppMessageOutboxFailed app_message_register_outbox_failed(
+		AppMessageOutboxFailed failed_callback) {
+	AppMessageOutboxFailed old = outbox_failed;
+	outbox_failed = failed_callback;
+	return old;
+}
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator) {
+	if (!outbox_open) {
+		return APP_MSG_INVALID_ARGS;
+	}
+	if (outbox_in_flight || outbox_iter.dictionary) {
+		shim_stats.busy_rejects++;
+		return APP_MSG_BUSY;
+	}
+	dict_write_begin(&outbox_iter, outbox_buffer, outbox_size);
+	*iterator = &outbox_iter;
+	return APP_MSG_OK;
+}
+
+AppMessageResult app_message_outbox_send(void) {
+	if (!outbox_iter.dictionary) {
+		return APP_MSG_INVALID_ARGS;
+	}
+	if (outbox_in_flight) {
+		return APP_MSG_BUSY;
+	}
+	// refused at once: the message is dropped and no callback follows
+	if (shim_config.refuse_permille
+			&& rng_next() % 1000 < shim_config.refuse_permille) {
+		shim_stats.msgs_refused++;
+		memset(&outbox_iter, 0, sizeof(outbox_iter));
+		return APP_MSG_INTERNAL_ERROR;
+	}
+
+	uint32_t bytes = dict_used(&outbox_iter);
+	shim_stats.msgs_sent++;
+	shim_stats.bytes_sent += bytes;
+	if (bytes > shim_stats.max_msg_bytes) {
+		shim_stats.max_msg_bytes = bytes;
+	}
+	dump_outbox();
+
+	outbox_in_flight = true;
+	outbox_done_ms = now_ms + shim_config.ack_latency_ms;
+	if (!bt_connected) {
+		outbox_result = APP_MSG_NOT_CONNECTED;
+	} else if (rng_next() % 1000 < shim_config.fail_permille) {
+		outbox_result = APP_MSG_SEND_TIMEOUT;
+	} else {
+		outbox_result = APP_MSG_OK;
+	}
+	return APP_MSG_OK;
+}
+
+static void outbox_complete(void) {
+	DictionaryIterator done = outbox_iter;
+	dict_read_first(&done);
+	outbox_in_flight = false;
+	outbox_done_ms = NEVER;
+	memset(&outbox_iter, 0, sizeof(outbox_iter));
+
+	if (outbox_result == APP_MSG_OK) {
+		shim_stats.msgs_acked++;
+		if (outbox_sent) {
+			outbox_sent(&done, message_context);
+		}
+	} else {
+		shim_stats.msgs_failed++;
+		if (outbox_failed) {
+			outbox_failed(&done, outbox_result, message_context);
+		}
+	}
+}
+
+static void dump_outbox(void) {
+	if (!shim_config.dump) {
+		return;
+	}
+	DictionaryIterator walk = outbox_iter;
+	walk.end = dict_written_end(&outbox_iter);
+	FILE *out = shim_config.dump;
+	fprintf(out, "{\"t\":%llu,\"payload\":{", (unsigned long long)now_ms);
+	bool first = true;
+	for (Tuple *t = dict_read_first(&walk); t; t = dict_read_next(&walk)) {
+		const uint8_t *bytes = (const uint8_t *)t->value;
+		fprintf(out, "%s\"%u\":", first ? "" : ",", (unsigned)t->key);
+		first = false;
+		switch (t->type) {
+			case TUPLE_CSTRING:
+				fputc('"', out);
+				for (int i = 0; i < t->length && bytes[i]; i++) {
+					char c = bytes[i];
+					if (c == '"' || c == '\\') {
+						fputc('\\', out);
+					}
+					fputc(c, out);
+				}
+				fputc('"', out);
+				break;
+			case TUPLE_BYTE_ARRAY:
+				fputc('[', out);
+				for (int i = 0; i < t->length; i++) {
+					fprintf(out, "%s%u", i ? "," : "", bytes[i]);
+				}
+				fputc(']', out);
+				break;
+			case TUPLE_INT:
+				fprintf(out, "%d", t->length == 1 ? t->value->int8
+					: t->length == 2 ? t->value->int16 : t->value->int32);
+				break;
+			case TUPLE_UINT:
+				fprintf(out, "%u", t->length == 1 ? t->value->uint8
+					: t->length == 2 ? t->value->uint16 : t->value->uint32);
+				break;
+		}
+	}
+	fprintf(out, "}}\n");
+}
+
+static void inbox_deliver(const ShimInbox *msg) {
+	if (!inbox_received || !inbox_buffer) {
+		return;
+	}
+	DictionaryIterator iter;
+	dict_write_begin(&iter, inbox_buffer, inbox_size);
+	for (uint32_t i = next_inbox; i < shim_config.num_inbox
+			&& shim_config.inbox[i].at_s == msg->at_s; i++) {
+		dict_write_int32(&iter, shim_config.inbox[i].key,
+			shim_config.inbox[i].value);
+		next_inbox = i + 1;
+	}
+	dict_write_end(&iter);
+	shim_stats.inbox_delivered++;
+	inbox_received(&iter, message_context);
+}
+
+void app_comm_set_sniff_interval(const SniffInterval interval) {
+	if (sniff == SNIFF_INTERVAL_REDUCED) {
+		shim_stats.sniff_reduced_ms += now_ms - sniff_since_ms;
+	}
+	sniff = interval;
+	sniff_since_ms = now_ms;
+}
+
+/* ========================================================================== */
+/* Timers and services                                                        */
+/* ========================================================================== */
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback,
+		void *callback_data) {
+	// hand out slots round-robin so a stale handle rarely aliases a new timer
+	for (int i = 0; i < MAX_TIMERS; i++) {
+		struct AppTimer *timer = &timers[(next_timer_slot + i) % MAX_TIMERS];
+		if (!timer->active) {
+			next_timer_slot = (next_timer_slot + i + 1) % MAX_TIMERS;
+			timer->due = now_ms + timeout_ms;
+			timer->callback = callback;
+			timer->data = callback_data;
+			timer->active = true;
+			return timer;
+		}
+	}
+	return NULL;
+}
+
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms) {
+	if (!timer_handle || !timer_handle->active) {
+		return false;
+	}
+	timer_handle->due = now_ms + new_timeout_ms;
+	return true;
+}
+
+void app_timer_cancel(AppTimer *timer_handle) {
+	if (timer_handle) {
+		timer_handle->active = false;
+	}
+}
+
+static uint64_t next_tick_after(uint64_t t, TimeUnits units) {
+	uint64_t step = (units & SECOND_UNIT) ? 1000 : 60000;
+	uint64_t wall = (uint64_t)shim_config.start_time * 1000 + t;
+	return (wall / step + 1) * step - (uint64_t)shim_config.start_time * 1000;
+}
+
+void tick_timer_service_subscribe(TimeUnits units, TickHandler handler) {
+	tick_units = units;
+	tick_handler = handler;
+	next_tick_ms = next_tick_after(now_ms, tick_units);
+}
+
+void tick_timer_service_unsubscribe(void) {
+	tick_handler = NULL;
+	next_tick_ms = NEVER;
+}
+
+static void accel_rearm(void) {
+	if (accel_handler || tap_handler) {
+		next_sensor_ms = now_ms + 1000 / accel_rate;
+	} else {
+		next_sensor_ms = NEVER;
+	}
+}
+
+void accel_data_service_subscribe(uint32_t samples_per_update,
+		AccelDataHandler handler) {
+	accel_handler = handler;
+	accel_service_set_samples_per_update(samples_per_update);
+	accel_rearm();
+}
+
+void accel_data_service_unsubscribe(void) {
+	accel_handler = NULL;
+	accel_batch_fill = 0;
+	accel_rearm();
+}
+
+int accel_service_set_sampling_rate(AccelSamplingRate rate) {
+	accel_rate = rate;
+	accel_rearm();
+	return 0;
+}
+
+int accel_service_set_samples_per_update(uint32_t num_samples) {
+	if (num_samples > 25) {
+		num_samples = 25;
+	}
+	shim_free(accel_batch);
+	accel_batch = shim_calloc(num_samples ? num_samples : 1,
+		sizeof(AccelData));
+	accel_batch_size = num_samples;
+	accel_batch_fill = 0;
+	return 0;
+}
+
+static AccelData sensor_read(void) {
+	AccelData sample = { .x = 0, .y = 0, .z = -1000 };
+	const ShimSample *trace = shim_config.trace;
+	uint32_t len = shim_config.trace_len;
+	if (trace && len) {
+		// loop the trace so short recordings can drive long runs
+		uint32_t span = trace[len - 1].t_ms + 1;
+		uint32_t t = now_ms % span;
+		uint32_t lo = 0, hi = len - 1;
+		while (lo < hi) {
+			uint32_t mid = (lo + hi + 1) / 2;
+			if (trace[mid].t_ms <= t) {
+				lo = mid;
+			} else {
+				hi = mid - 1;
+			}
+		}
+		sample.x = trace[lo].x;
+		sample.y = trace[lo].y;
+		sample.z = trace[lo].z;
+	}
+	sample.did_vibrate = now_ms < vibe_until_ms;
+	sample.timestamp = (uint64_t)shim_config.start_time * 1000 + now_ms;
+	return sample;
+}
+
+static void sensor_tick(void) {
+	AccelData sample = sensor_read();
+
+	if (tap_handler && have_last_sample
+			&& now_ms - last_tap_ms > TAP_REFRACTORY_MS) {
+		int dx = abs(sample.x - last_sample.x);
+		int dy = abs(sample.y - last_sample.y);
+		int dz = abs(sample.z - last_sample.z);
+		AccelAxisType axis = dx >= dy && dx >= dz ? ACCEL_AXIS_X
+			: dy >= dz ? ACCEL_AXIS_Y : ACCEL_AXIS_Z;
+		if (dx + dy + dz > TAP_THRESHOLD) {
+			last_tap_ms = now_ms;
+			shim_stats.taps_delivered++;
+			tap_handler(axis, 1);
+		}
+	}
+	last_sample = sample;
+	have_last_sample = true;
+
+	if (accel_handler && accel_batch) {
+		accel_batch[accel_batch_fill++] = sample;
+		shim_stats.samples_delivered++;
+		if (accel_batch_fill >= accel_batch_size) {
+			accel_batch_fill = 0;
+			shim_stats.batches_delivered++;
+			accel_handler(accel_batch, accel_batch_size);
+		}
+	}
+}
+
+void accel_tap_service_subscribe(AccelTapHandler handler) {
+	tap_handler = handler;
+	accel_rearm();
+}
+
+void accel_tap_service_unsubscribe(void) {
+	tap_handler = NULL;
+	accel_rearm();
+}
+
+int accel_service_peek(AccelData *data) {
+	*data = sensor_read();
+	return 0;
+}
+
+BatteryChargeState battery_state_service_peek(void) {
+	return (BatteryChargeState) {
+		.charge_percent = shim_config.battery_percent,
+	};
+}
+
+bool bluetooth_connection_service_peek(void) {
+	return bt_connected;
+}
+
+void bluetooth_connection_service_subscribe(
+		BluetoothConnectionHandler handler) {
+	bt_handler = handler;
+}
+
+void bluetooth_connection_service_unsubscribe(void) {
+	bt_handler = NULL;
+}
+
+static bool bt_scheduled_state(uint64_t t) {
+	for (uint32_t i = 0; i < shim_config.num_bt_gaps; i++) {
+		const ShimGap *gap = &shim_config.bt_gaps[i];
+		if (t >= gap->start_s * 1000ull && t < gap->end_s * 1000ull) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static uint64_t next_bt_change(void) {
+	// an edge that fell on the same ms as another event is still due
+	if (bt_scheduled_state(now_ms) != bt_connected) {
+		return now_ms;
+	}
+	uint64_t next = NEVER;
+	for (uint32_t i = 0; i < shim_config.num_bt_gaps; i++) {
+		uint64_t edges[2] = { shim_config.bt_gaps[i].start_s * 1000ull,
+			shim_config.bt_gaps[i].end_s * 1000ull };
+		for (int e = 0; e < 2; e++) {
+			if (edges[e] > now_ms && edges[e] < next) {
+				next = edges[e];
+			}
+		}
+	}
+	return next;
+}
+
+/* ========================================================================== */
+/* Persistent storage                                                         */
+/* ========================================================================== */
+
+static PersistEntry *persist_find(uint32_t key) {
+	for (int i = 0; i < MAX_PERSIST; i++) {
+		if (persist[i].used && persist[i].key == key) {
+			return &persist[i];
+		}
+	}
+	return NULL;
+}
+
+static int persist_total(void) {
+	int total = 0;
+	for (int i = 0; i < MAX_PERSIST; i++) {
+		if (persist[i].used) {
+			total += persist[i].length;
+		}
+	}
+	return total;
+}
+
+static int persist_store(uint32_t key, const void *data, size_t size) {
+	if (size > PERSIST_DATA_MAX_LENGTH) {
+		size = PERSIST_DATA_MAX_LENGTH;
+	}
+	PersistEntry *entry = persist_find(key);
+	int existing = entry ? entry->length : 0;
+	if (persist_total() - existing + (int)size > PERSIST_TOTAL_MAX) {
+		return E_OUT_OF_STORAGE;
+	}
+	for (int i = 0; !entry && i < MAX_PERSIST; i++) {
+		if (!persist[i].used) {
+			entry = &persist[i];
+		}
+	}
+	if (!entry) {
+		return E_OUT_OF_STORAGE;
+	}
+	entry->used = true;
+	entry->key = key;
+	entry->length = size;
+	memcpy(entry->data, data, size);
+	shim_stats.persist_writes++;
+	shim_stats.persist_bytes_written += size;
+	return size;
+}
+
+bool persist_exists(const uint32_t key) {
+	return persist_find(key) != NULL;
+}
+
+int persist_get_size(const uint32_t key) {
+	PersistEntry *entry = persist_find(key);
+	return entry ? entry->length : E_DOES_NOT_EXIST;
+}
+
+int32_t persist_read_int(const uint32_t key) {
+	int32_t value = 0;
+	persist_read_data(key, &value, sizeof(value));
+	return value;
+}
+
+int persist_read_data(const uint32_t key, void *buffer,
+		const size_t buffer_size) {
+	PersistEntry *entry = persist_find(key);
+	shim_stats.persist_reads++;
+	if (!entry) {
+		return E_DOES_NOT_EXIST;
+	}
+	size_t n = entry->length < buffer_size ? entry->length : buffer_size;
+	memcpy(buffer, entry->data, n);
+	return n;
+}
+
+int persist_read_string(const uint32_t key, char *buffer,
+		const size_t buffer_size) {
+	int n = persist_read_data(key, buffer, buffer_size);
+	if (n > 0) {
+		buffer[(size_t)n < buffer_size ? (size_t)n : buffer_size - 1] = '\0';
+	}
+	return n;
+}
+
+status_t persist_write_int(const uint32_t key, const int32_t value) {
+	return persist_store(key, &value, sizeof(value));
+}
+
+int persist_write_data(const uint32_t key, const void *data,
+		const size_t size) {
+	return persist_store(key, data, size);
+}
+
+int persist_write_string(const uint32_t key, const char *cstring) {
+	return persist_store(key, cstring, strlen(cstring) + 1);
+}
+
+status_t persist_delete(const uint32_t key) {
+	PersistEntry *entry = persist_find(key);
+	if (!entry) {
+		return E_DOES_NOT_EXIST;
+	}
+	entry->used = false;
+	return S_SUCCESS;
+}
+
+/* ========================================================================== */
+/* Vibes                                                                      */
+/* ========================================================================== */
+
+void vibes_enqueue_custom_pattern(VibePattern pattern) {
+	uint64_t total = 0;
+	for (uint32_t i = 0; i < pattern.num_segments; i++) {
+		total += pattern.durations[i];
+	}
+	shim_stats.vibes++;
+	vibe_until_ms = now_ms + total;
+}
+
+void vibes_short_pulse(void) {
+	shim_stats.vibes++;
+	vibe_until_ms = now_ms + 100;
+}
+
+void vibes_long_pulse(void) {
+	shim_stats.vibes++;
+	vibe_until_ms = now_ms + 500;
+}
+
+void vibes_double_pulse(void) {
+	shim_stats.vibes++;
+	vibe_until_ms = now_ms + 300;
+}
+
+void vibes_cancel(void) {
+	vibe_until_ms = now_ms;
+}
+
+/* ========================================================================== */
+/* Graphics, layers and windows                                               */
+/* ========================================================================== */
+
+GFont fonts_get_system_font(const char *font_key) {
+	return font_key;
+}
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color) {
+	ctx->fill = color;
+}
+
+void graphics_context_set_stroke_color(GContext *ctx, GColor color) {
+}
+
+void graphics_context_set_text_color(GContext *ctx, GColor color) {
+}
+
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius,
+		GCornerMask corner_mask) {
+	shim_stats.fill_rects++;
+}
+
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1) {
+}
+
+void graphics_draw_text(GContext *ctx, const char *text, const GFont font,
+		const GRect box, const GTextOverflowMode overflow_mode,
+		const GTextAlignment alignment, const GTextLayoutCacheRef layout) {
+	shim_stats.text_draws++;
+}
+
+static void register_layer(struct Layer *layer, GRect frame) {
+	*layer = (struct Layer) {
+		.frame = frame,
+		.dirty = true,
+		.next_registered = layers,
+	};
+	layers = layer;
+}
+
+static void unregister_layer(struct Layer *layer) {
+	for (struct Layer **at = &layers; *at; at = &(*at)->next_registered) {
+		if (*at == layer) {
+			*at = layer->next_registered;
+			return;
+		}
+	}
+}
+
+Layer *layer_create(GRect frame) {
+	struct Layer *layer = shim_malloc(sizeof(*layer));
+	register_layer(layer, frame);
+	return layer;
+}
+
+Layer *layer_create_with_data(GRect frame, size_t data_size) {
+	struct Layer *layer = layer_create(frame);
+	layer->data = shim_calloc(1, data_size);
+	return layer;
+}
+
+void *layer_get_data(const Layer *layer) {
+	return layer->data;
+}
+
+void layer_destroy(Layer *layer) {
+	if (!layer) {
+		return;
+	}
+	unregister_layer(layer);
+	shim_free(layer->data);
+	shim_free(layer);
+}
+
+void layer_mark_dirty(Layer *layer) {
+	layer->dirty = true;
+}
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc) {
+	layer->update_proc = update_proc;
+}
+
+void layer_set_frame(Layer *layer, GRect frame) {
+	layer->frame = frame;
+	layer->dirty = true;
+}
+
+GRect layer_get_frame(const Layer *layer) {
+	return layer->frame;
+}
+
+GRect layer_get_bounds(const Layer *layer) {
+	return (GRect) { .origin = { 0, 0 }, .size = layer->frame.size };
+}
+
+void layer_add_child(Layer *parent, Layer *child) {
+	child->parent = parent;
+	child->dirty = true;
+}
+
+void layer_remove_from_parent(Layer *child) {
+	child->parent = NULL;
+}
+
+void layer_set_hidden(Layer *layer, bool hidden) {
+	if (layer->hidden != hidden) {
+		layer->hidden = hidden;
+		layer->dirty = true;
+	}
+}
+
+bool layer_get_hidden(const Layer *layer) {
+	return layer->hidden;
+}
+
+TextLayer *text_layer_create(GRect frame) {
+	struct TextLayer *text_layer = shim_malloc(sizeof(*text_layer));
+	register_layer(&text_layer->layer, frame);
+	text_layer->layer.text = text_layer;
+	text_layer->text = NULL;
+	text_layer->background = GColorWhite;
+	return text_layer;
+}
+
+void text_layer_destroy(TextLayer *text_layer) {
+	if (!text_layer) {
+		return;
+	}
+	unregister_layer(&text_layer->layer);
+	shim_free(text_layer);
+}
+
+Layer *text_layer_get_layer(TextLayer *text_layer) {
+	return &text_layer->layer;
+}
+
+void text_layer_set_text(TextLayer *text_layer, const char *text) {
+	text_layer->text = text;
+	text_layer->layer.dirty = true;
+}
+
+const char *text_layer_get_text(TextLayer *text_layer) {
+	return text_layer->text;
+}
+
+void text_layer_set_background_color(TextLayer *text_layer, GColor color) {
+	text_layer->background = color;
+	text_layer->layer.dirty = true;
+}
+
+void text_layer_set_text_color(TextLayer *text_layer, GColor color) {
+	text_layer->layer.dirty = true;
+}
+
+void text_layer_set_font(TextLayer *text_layer, GFont font) {
+	text_layer->layer.dirty = true;
+}
+
+void text_layer_set_text_alignment(TextLayer *text_layer,
+		GTextAlignment text_alignment) {
+	text_layer->layer.dirty = true;
+}
+
+void text_layer_set_size(TextLayer *text_layer, const GSize max_size) {
+	text_layer->layer.frame.size = max_size;
+	text_layer->layer.dirty = true;
+}
+
+// stands in for the compositor: every dirty, attached layer is redrawn once
+static void render(void) {
+	GContext ctx = { .fill = GColorBlack };
+	for (struct Layer *layer = layers; layer; layer = layer->next_registered) {
+		if (!layer->dirty) {
+			continue;
+		}
+		layer->dirty = false;
+		if (!layer->parent || layer->hidden) {
+			continue;
+		}
+		shim_stats.redraws++;
+		if (layer->text) {
+			if (layer->text->background != GColorClear) {
+				graphics_fill_rect(&ctx, layer->frame, 0, GCornerNone);
+			}
+			if (layer->text->text && layer->text->text[0]) {
+				graphics_draw_text(&ctx, layer->text->text, NULL,
+					layer->frame, GTextOverflowModeWordWrap,
+					GTextAlignmentLeft, NULL);
+			}
+		} else if (layer->update_proc) {
+			layer->update_proc(layer, &ctx);
+		}
+	}
+}
+
+Window *window_create(void) {
+	struct Window *window = shim_calloc(1, sizeof(*window));
+	register_layer(&window->root, GRect(0, 0, 144, 168));
+	window->root.parent = &window->root;
+	return window;
+}
+
+void window_destroy(Window *window) {
+	if (!window) {
+		return;
+	}
+	window_stack_remove(window, false);
+	unregister_layer(&window->root);
+	shim_free(window);
+}
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers) {
+	window->handlers = handlers;
+}
+
+void window_set_background_color(Window *window, GColor background_color) {
+}
+
+Layer *window_get_root_layer(const Window *window) {
+	return (Layer *)&window->root;
+}
+
+void window_stack_push(Window *window, bool animated) {
+	if (window_count == MAX_WINDOWS) {
+		return;
+	}
+	window_stack[window_count++] = window;
+	if (!window->loaded) {
+		window->loaded = true;
+		if (window->handlers.load) {
+			window->handlers.load(window);
+		}
+	}
+	if (window->handlers.appear) {
+		window->handlers.appear(window);
+	}
+}
+
+Window *window_stack_remove(Window *window, bool animated) {
+	for (int i = 0; i < window_count; i++) {
+		if (window_stack[i] != window) {
+			continue;
+		}
+		memmove(&window_stack[i], &window_stack[i + 1],
+			(window_count - i - 1) * sizeof(window_stack[0]));
+		window_count--;
+		if (window->handlers.disappear) {
+			window->handlers.disappear(window);
+		}
+		if (window->loaded) {
+			window->loaded = false;
+			if (window->handlers.unload) {
+				window->handlers.unload(window);
+			}
+		}
+		return window;
+	}
+	return NULL;
+}
+
+Window *window_stack_pop(bool animated) {
+	if (window_count == 0) {
+		return NULL;
+	}
+	return window_stack_remove(window_stack[window_count - 1], animated);
+}
+
+bool window_stack_contains_window(Window *window) {
+	for (int i = 0; i < window_count; i++) {
+		if (window_stack[i] == window) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* ========================================================================== */
+/* Animation                                                                  */
+/* ========================================================================== */
+
+Animation *animation_create(void) {
+	struct Animation *animation = shim_calloc(1, sizeof(*animation));
+	animation->duration = 250;
+	return animation;
+}
+
+void animation_destroy(Animation *animation) {
+	animation_unschedule(animation);
+	shim_free(animation);
+}
+
+void animation_set_duration(Animation *animation, uint32_t duration_ms) {
+	animation->duration = duration_ms;
+}
+
+void animation_set_implementation(Animation *animation,
+		const AnimationImplementation *implementation) {
+	animation->impl = implementation;
+}
+
+void animation_schedule(Animation *animation) {
+	for (int i = 0; i < MAX_ANIMATIONS; i++) {
+		if (!animations[i]) {
+			animations[i] = animation;
+			animation->scheduled = true;
+			animation->start = now_ms;
+			animation->next_frame = now_ms;
+			if (animation->impl && animation->impl->setup) {
+				animation->impl->setup(animation);
+			}
+			return;
+		}
+	}
+}
+
+void animation_unschedule(Animation *animation) {
+	for (int i = 0; i < MAX_ANIMATIONS; i++) {
+		if (animations[i] == animation) {
+			animations[i] = NULL;
+		}
+	}
+	animation->scheduled = false;
+}
+
+bool animation_is_scheduled(Animation *animation) {
+	return animation->scheduled;
+}
+
+static void animation_frame(struct Animation *animation) {
+	uint64_t elapsed = now_ms - animation->start;
+	bool done = elapsed >= animation->duration;
+	uint32_t normalized = done ? ANIMATION_NORMALIZED_MAX
+		: (uint32_t)(elapsed * ANIMATION_NORMALIZED_MAX / animation->duration);
+
+	shim_stats.anim_frames++;
+	if (animation->impl && animation->impl->update) {
+		animation->impl->update(animation, normalized);
+	}
+	if (done) {
+		animation_unschedule(animation);
+		if (animation->impl && animation->impl->teardown) {
+			animation->impl->teardown(animation);
+		}
+	} else {
+		animation->next_frame = now_ms + ANIM_FRAME_MS;
+	}
+}
+
+/* ========================================================================== */
+/* Event loop                                                                 */
+/* ========================================================================== */
+
+static void count_wakeup(uint64_t started) {
+	shim_stats.wakeups++;
+	if (now_ms - started > shim_stats.max_stall_ms) {
+		shim_stats.max_stall_ms = now_ms - started;
+	}
+	render();
+}
+
+void app_event_loop(void) {
+	uint64_t end = (uint64_t)shim_config.duration_s * 1000;
+	rng_state = shim_config.seed;
+	bt_connected = bt_scheduled_state(now_ms);
+	render();
+
+	while (now_ms < end) {
+		// find the earliest pending event of any kind
+		uint64_t next = NEVER;
+		struct AppTimer *timer = NULL;
+		for (int i = 0; i < MAX_TIMERS; i++) {
+			if (timers[i].active && timers[i].due < next) {
+				next = timers[i].due;
+				timer = &timers[i];
+			}
+		}
+		struct Animation *animation = NULL;
+		for (int i = 0; i < MAX_ANIMATIONS; i++) {
+			if (animations[i] && animations[i]->next_frame < next) {
+				next = animations[i]->next_frame;
+				animation = animations[i];
+				timer = NULL;
+			}
+		}
+		uint64_t bt_change = next_bt_change();
+		uint64_t inbox_at = next_inbox < shim_config.num_inbox
+			? shim_config.inbox[next_inbox].at_s * 1000ull : NEVER;
+		uint64_t candidates[] = { next_sensor_ms, next_tick_ms,
+			outbox_done_ms, bt_change, inbox_at };
+		for (size_t i = 0; i < ARRAY_LENGTH(candidates); i++) {
+			if (candidates[i] < next) {
+				next = candidates[i];
+				timer = NULL;
+				animation = NULL;
+			}
+		}
+		if (next >= end) {
+			break;
+		}
+		if (next > now_ms) {
+			now_ms = next;
+		}
+
+		uint64_t started = now_ms;
+		if (timer) {
+			timer->active = false;
+			shim_stats.timer_fires++;
+			timer->callback(timer->data);
+		} else if (animation) {
+			animation_frame(animation);
+		} else if (next == next_sensor_ms) {
+			next_sensor_ms += 1000 / accel_rate;
+			sensor_tick();
+		} else if (next == next_tick_ms) {
+			time_t wall = shim_time(NULL);
+			struct tm *tick_time = localtime(&wall);
+			TimeUnits changed = SECOND_UNIT;
+			if (tick_time->tm_sec == 0) {
+				changed |= MINUTE_UNIT;
+				if (tick_time->tm_min == 0) {
+					changed |= HOUR_UNIT;
+					if (tick_time->tm_hour == 0) {
+						changed |= DAY_UNIT;
+					}
+				}
+			}
+			next_tick_ms = next_tick_after(now_ms, tick_units);
+			shim_stats.tick_fires++;
+			if (tick_handler) {
+				uint64_t allocs = shim_stats.allocs;
+				uint64_t reads = shim_stats.persist_reads;
+				struct timespec t0, t1;
+				clock_gettime(CLOCK_MONOTONIC, &t0);
+				tick_handler(tick_time, changed);
+				clock_gettime(CLOCK_MONOTONIC, &t1);
+				shim_stats.tick_host_ns += (t1.tv_sec - t0.tv_sec) * 1000000000ull
+					+ t1.tv_nsec - t0.tv_nsec;
+				shim_stats.tick_allocs += shim_stats.allocs - allocs;
+				shim_stats.tick_persist_reads += shim_stats.persist_reads - reads;
+			}
+		} else if (next == outbox_done_ms) {
+			outbox_complete();
+		} else if (next == bt_change) {
+			bt_connected = bt_scheduled_state(now_ms);
+			if (bt_handler) {
+				bt_handler(bt_connected);
+			}
+		} else {
+			inbox_deliver(&shim_config.inbox[next_inbox]);
+		}
+		count_wakeup(started);
+	}
+
+	if (now_ms < end) {
+		now_ms = end;
+	}
+	app_comm_set_sniff_interval(sniff);
+	shim_stats.elapsed_ms = now_ms;
+}
+
+/* ========================================================================== */
+/* Traces and report                                                          */
+/* ========================================================================== */
+
+uint32_t shim_load_trace(const char *path, ShimSample **out) {
+	FILE *in = fopen(path, "r");
+	if (!in) {
+		return 0;
+	}
+	uint32_t cap = 1024, len = 0;
+	ShimSample *samples = malloc(cap * sizeof(*samples));
+	char line[128];
+	while (fgets(line, sizeof(line), in)) {
+		unsigned t;
+		int x, y, z, label = 0;
+		if (sscanf(line, "%u,%d,%d,%d,%d", &t, &x, &y, &z, &label) < 4) {
+			continue; // header or comment
+		}
+		if (len == cap) {
+			cap *= 2;
+			samples = realloc(samples, cap * sizeof(*samples));
+		}
+		samples[len++] = (ShimSample) { t, x, y, z, label };
+	}
+	fclose(in);
+	*out = samples;
+	return len;
+}
+
+// labels used by the synthetic traces
+enum { SYNTH_STILL = 1, SYNTH_WALK, SYNTH_RUN, SYNTH_CYCLE };
+
+static ShimSample synth_sample(int kind, uint32_t t_ms) {
+	double t = t_ms / 1000.0;
+	double noise[3];
+	for (int i = 0; i < 3; i++) {
+		noise[i] = (int)(rng_next() % 41) - 20;
+	}
+	double x = 0, y = 0, z = -1000, f;
+	switch (kind) {
+		case SYNTH_WALK:
+			f = 1.8;
+			x = 180 * sin(2 * M_PI * f / 2 * t);
+			y = 120 * sin(2 * M_PI * f * t + 0.5);
+			z = -1000 + 320 * sin(2 * M_PI * f * t);
+			break;
+		case SYNTH_RUN:
+			f = 2.7;
+			x = 450 * sin(2 * M_PI * f / 2 * t);
+			y = 300 * sin(2 * M_PI * f * t + 0.7);
+			z = -1000 + 900 * sin(2 * M_PI * f * t);
+			break;
+		case SYNTH_CYCLE:
+			f = 1.3;
+			x = 200 + 60 * sin(2 * M_PI * f * t);
+			y = -300 + 40 * sin(2 * M_PI * f * t + 1.0);
+			z = -900 + 90 * sin(2 * M_PI * 2 * f * t);
+			break;
+		default:
+			for (int i = 0; i < 3; i++) {
+				noise[i] /= 4;
+			}
+			break;
+	}
+	return (ShimSample) { t_ms, x + noise[0], y + noise[1], z + noise[2],
+		kind };
+}
+
+uint32_t shim_synth_trace(const char *kind, uint32_t seconds, uint32_t seed,
+		ShimSample **out) {
+	static const char *kinds[] = { "still", "walk", "run", "cycle" };
+	int fixed = 0;
+	for (size_t i = 0; i < ARRAY_LENGTH(kinds); i++) {
+		if (!strcmp(kind, kinds[i])) {
+			fixed = i + 1;
+		}
+	}
+	if (!fixed && strcmp(kind, "mixed")) {
+		return 0;
+	}
+
+	// 100 Hz so every subscribed sampling rate can be served from it
+	uint32_t len = seconds * 100;
+	ShimSample *samples = malloc(len * sizeof(*samples));
+	rng_state = seed;
+	for (uint32_t i = 0; i < len; i++) {
+		uint32_t t_ms = i * 10;
+		// "mixed" cycles through every activity in one-minute segments
+		int k = fixed ? fixed : (int)(t_ms / 60000) % 4 + 1;
+		samples[i] = synth_sample(k, t_ms);
+	}
+	*out = samples;
+	return len;
+}
+
+void shim_report(FILE *out) {
+	ShimStats *s = &shim_stats;
+	double minutes = s->elapsed_ms / 60000.0;
+	if (minutes <= 0) {
+		minutes = 1;
+	}
+	fprintf(out, "simulated:        %.1f s\n", s->elapsed_ms / 1000.0);
+	fprintf(out, "accel samples:    %llu in %llu batches, %llu taps\n",
+		(unsigned long long)s->samples_delivered,
+		(unsigned long long)s->batches_delivered,
+		(unsigned long long)s->taps_delivered);
+	fprintf(out, "outbox messages:  %llu sent, %llu acked, %llu failed, "
+		"%llu refused, %llu busy\n", (unsigned long long)s->msgs_sent,
+		(unsigned long long)s->msgs_acked,
+		(unsigned long long)s->msgs_failed,
+		(unsigned long long)s->msgs_refused,
+		(unsigned long long)s->busy_rejects);
+	fprintf(out, "outbox bytes:     %llu total, %.1f per message, %llu max, "
+		"%.2f msgs/s\n", (unsigned long long)s->bytes_sent,
+		s->msgs_sent ? (double)s->bytes_sent / s->msgs_sent : 0.0,
+		(unsigned long long)s->max_msg_bytes,
+		s->msgs_sent / (minutes * 60));
+	fprintf(out, "inbox messages:   %llu\n",
+		(unsigned long long)s->inbox_delivered);
+	fprintf(out, "wakeups:          %llu (%.1f/min), %llu timer, "
+		"%llu tick, %llu anim\n", (unsigned long long)s->wakeups,
+		s->wakeups / minutes, (unsigned long long)s->timer_fires,
+		(unsigned long long)s->tick_fires,
+		(unsigned long long)s->anim_frames);
+	fprintf(out, "timer wakeups:    %.1f/min\n", s->timer_fires / minutes);
+	double ticks = s->tick_fires ? s->tick_fires : 1;
+	fprintf(out, "tick handler:     %.0f host ns, %.2f allocations, "
+		"%.2f persist reads per tick\n", s->tick_host_ns / ticks,
+		s->tick_allocs / ticks, s->tick_persist_reads / ticks);
+	fprintf(out, "max stall:        %llu ms\n",
+		(unsigned long long)s->max_stall_ms);
+	fprintf(out, "persist:          %llu reads, %llu writes, %llu bytes "
+		"written, %d bytes stored\n", (unsigned long long)s->persist_reads,
+		(unsigned long long)s->persist_writes,
+		(unsigned long long)s->persist_bytes_written, persist_total());
+	fprintf(out, "heap:             %llu now, %llu peak, %llu allocations\n",
+		(unsigned long long)s->heap_now, (unsigned long long)s->heap_peak,
+		(unsigned long long)s->allocs);
+	fprintf(out, "sniff reduced:    %.1f s\n", s->sniff_reduced_ms / 1000.0);
+	fprintf(out, "display:          %llu redraws, %llu fill rects, "
+		"%llu text draws\n", (unsigned long long)s->redraws,
+		(unsigned long long)s->fill_rects,
+		(unsigned long long)s->text_draws);
+	fprintf(out, "vibes:            %llu\n", (unsigned long long)s->vibes);
+}
@@ -0,0 +1,135 @@
+/* ========================================================================== */
+/* File: replay.c
+ *
+ * Drives the unmodified watch app (src/pebble-fuel.c + src/strap) on the
+ * host shim with a recorded or synthesized accelerometer trace and prints
+ * message, wakeup, persistence and heap counters for the run.
+ *
+ * See README.md in this directory for the build line.
+ *
+ * Usage:
+ *
+ *   replay [--trace file.csv | --synth still|walk|run|cycle|mixed]
+ *          [--duration s] [--latency ms] [--fail permille]
+ *          [--refuse permille] [--seed n]
+ *          [--bt-off start:end]... [--inbox s:key=value]... [--tz zone]
+ *          [--start epoch] [--battery pct] [--dump out.jsonl] [-v]
+ *
+ * Trace files are CSV rows of "t_ms,x,y,z[,label]" with t_ms relative to the
+ * start of the recording; the trace loops if the run is longer than it.
+ */
+/* ========================================================================== */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shim.h"
+
+// the app's main() is renamed on the command line; this one is the host's
+#undef main
+int pebble_app_main(void);
+
+static void usage(const char *argv0) {
+	fprintf(stderr, "usage: %s [--trace file.csv | --synth kind] "
+		"[--duration s] [--latency ms] [--fail permille] "
+		"[--refuse permille] [--max-failed n] [--seed n] "
+		"[--bt-off start:end] [--inbox s:key=value] [--tz zone] "
+		"[--start epoch] [--battery pct] [--dump out.jsonl] [-v]\n", argv0);
+	exit(2);
+}
+
+int main(int argc, char **argv) {
+	const char *trace_path = NULL;
+	const char *synth = "mixed";
+	ShimConfig *cfg = &shim_config;
+	long max_failed = -1;
+
+	cfg->start_time = 1402819200; // 2014-06-15 08:00 UTC
+	cfg->seed = 1;
+	setenv("TZ", "UTC", 1);
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+		if (!strcmp(arg, "-v")) {
+			cfg->verbose = 1;
+			continue;
+		}
+		if (!val) {
+			usage(argv[0]);
+		}
+		i++;
+		if (!strcmp(arg, "--trace")) {
+			trace_path = val;
+		} else if (!strcmp(arg, "--synth")) {
+			synth = val;
+		} else if (!strcmp(arg, "--duration")) {
+			cfg->duration_s = atoi(val);
+		} else if (!strcmp(arg, "--latency")) {
+			cfg->ack_latency_ms = atoi(val);
+		} else if (!strcmp(arg, "--fail")) {
+			cfg->fail_permille = atoi(val);
+		} else if (!strcmp(arg, "--refuse")) {
+			cfg->refuse_permille = atoi(val);
+		} else if (!strcmp(arg, "--max-failed")) {
+			max_failed = atol(val);
+		} else if (!strcmp(arg, "--seed")) {
+			cfg->seed = atoi(val);
+		} else if (!strcmp(arg, "--start")) {
+			cfg->start_time = atol(val);
+		} else if (!strcmp(arg, "--battery")) {
+			cfg->battery_percent = atoi(val);
+		} else if (!strcmp(arg, "--tz")) {
+			setenv("TZ", val, 1);
+		} else if (!strcmp(arg, "--bt-off")) {
+			ShimGap *gap = &cfg->bt_gaps[cfg->num_bt_gaps];
+			if (cfg->num_bt_gaps == SHIM_MAX_BT_GAPS
+					|| sscanf(val, "%u:%u", &gap->start_s, &gap->end_s) != 2) {
+				usage(argv[0]);
+			}
+			cfg->num_bt_gaps++;
+		} else if (!strcmp(arg, "--inbox")) {
+			ShimInbox *msg = &cfg->inbox[cfg->num_inbox];
+			if (cfg->num_inbox == SHIM_MAX_INBOX || sscanf(val, "%u:%u=%d",
+					&msg->at_s, &msg->key, &msg->value) != 3) {
+				usage(argv[0]);
+			}
+			cfg->num_inbox++;
+		} else if (!strcmp(arg, "--dump")) {
+			cfg->dump = fopen(val, "w");
+			if (!cfg->dump) {
+				perror(val);
+				return 1;
+			}
+		} else {
+			usage(argv[0]);
+		}
+	}
+	tzset();
+
+	ShimSample *trace = NULL;
+	uint32_t len = trace_path ? shim_load_trace(trace_path, &trace)
+		: shim_synth_trace(synth, 240, cfg->seed, &trace);
+	if (!len) {
+		fprintf(stderr, "no samples in %s\n", trace_path ? trace_path : synth);
+		return 1;
+	}
+	cfg->trace = trace;
+	cfg->trace_len = len;
+
+	pebble_app_main();
+
+	shim_report(stdout);
+	if (cfg->dump) {
+		fclose(cfg->dump);
+	}
+	free(trace);
+
+	uint64_t failed = shim_stats.msgs_failed + shim_stats.msgs_refused;
+	if (max_failed >= 0 && failed > (uint64_t)max_failed) {
+		fprintf(stderr, "%llu sends failed or refused, expected at most %ld\n",
+			(unsigned long long)failed, max_failed);
+		return 1;
+	}
+	return 0;
+}
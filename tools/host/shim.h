@@ -0,0 +1,106 @@
+/* ========================================================================== */
+/* File: shim.h
+ *
+ * Controls and counters of the host Pebble shim. The replay driver fills in
+ * a ShimConfig, runs the watch app's main() against it and reads the
+ * ShimStats back once the simulated event loop has drained.
+ */
+/* ========================================================================== */
+#ifndef SHIM_H
+#define SHIM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#define SHIM_MAX_BT_GAPS 16
+#define SHIM_MAX_INBOX 32
+
+// one recorded accelerometer reading
+typedef struct {
+	uint32_t t_ms;     // offset from the start of the trace
+	int16_t x;
+	int16_t y;
+	int16_t z;
+	uint8_t label;     // optional activity label, 0 if unknown
+} ShimSample;
+
+// a window of time during which the phone is out of range
+typedef struct {
+	uint32_t start_s;
+	uint32_t end_s;
+} ShimGap;
+
+// a message the phone pushes to the watch inbox at a given time
+typedef struct {
+	uint32_t at_s;
+	uint32_t key;
+	int32_t value;
+} ShimInbox;
+
+typedef struct {
+	const ShimSample *trace;
+	uint32_t trace_len;
+	time_t start_time;        // wall clock at t = 0
+	uint32_t duration_s;      // how long to run the event loop
+	uint32_t ack_latency_ms;  // outbox send to sent/failed callback
+	uint32_t fail_permille;   // share of sends the phone drops
+	uint32_t refuse_permille; // share of sends refused outright
+	uint32_t seed;
+	ShimGap bt_gaps[SHIM_MAX_BT_GAPS];
+	uint32_t num_bt_gaps;
+	ShimInbox inbox[SHIM_MAX_INBOX];
+	uint32_t num_inbox;
+	uint8_t battery_percent;
+	int verbose;
+	FILE *dump;               // JSON line per outbox message, or NULL
+} ShimConfig;
+
+typedef struct {
+	uint64_t samples_delivered;
+	uint64_t batches_delivered;
+	uint64_t taps_delivered;
+	uint64_t msgs_sent;
+	uint64_t msgs_acked;
+	uint64_t msgs_failed;
+	uint64_t msgs_refused;
+	uint64_t busy_rejects;
+	uint64_t bytes_sent;
+	uint64_t max_msg_bytes;
+	uint64_t inbox_delivered;
+	uint64_t timer_fires;
+	uint64_t tick_fires;
+	uint64_t anim_frames;
+	uint64_t wakeups;
+	uint64_t max_stall_ms;
+	uint64_t persist_reads;
+	uint64_t persist_writes;
+	uint64_t persist_bytes_written;
+	uint64_t allocs;
+	uint64_t heap_now;
+	uint64_t heap_peak;
+	uint64_t sniff_reduced_ms;
+	uint64_t redraws;
+	uint64_t fill_rects;
+	uint64_t text_draws;
+	uint64_t vibes;
+	uint64_t tick_host_ns;      // host time spent in the tick handler
+	uint64_t tick_allocs;       // allocations made by the tick handler
+	uint64_t tick_persist_reads;
+	uint64_t elapsed_ms;
+} ShimStats;
+
+extern ShimConfig shim_config;
+extern ShimStats shim_stats;
+
+// loads a CSV trace of "t_ms,x,y,z[,label]" rows, returns sample count
+uint32_t shim_load_trace(const char *path, ShimSample **out);
+
+// synthesizes a deterministic trace of the given kind
+uint32_t shim_synth_trace(const char *kind, uint32_t seconds, uint32_t seed,
+	ShimSample **out);
+
+// prints the counters gathered during the run
+void shim_report(FILE *out);
+
+#endif // SHIM_H
@@ -0,0 +1,108 @@
+// ==========================================================================
+// upload_decode.js
+//
+// Reference decoder for the accel uploads written by pebble-js-app.js:
+// accl= holds a URL-encoded JSON array, accl_col= the columnar encoding
+// described above strap_api_encodeUpload. Both decode to the same
+// [{ ts, x, y, z, vib, act }] readings.
+// ==========================================================================
+
+var COL_VERSION = 1;
+var ABC = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+function unbase64(s) {
+    var b = [];
+    for (var i = 0; i < s.length; i += 4) {
+        var v = 0;
+        for (var j = 0; j < 4; j++) {
+            v = v << 6 | (i + j < s.length ? ABC.indexOf(s[i + j]) : 0);
+        }
+        var chars = Math.min(4, s.length - i);
+        b.push(v >> 16 & 0xff);
+        if (chars > 2) b.push(v >> 8 & 0xff);
+        if (chars > 3) b.push(v & 0xff);
+    }
+    return b;
+}
+
+function decodeColumns(s) {
+    var b = unbase64(s);
+    var pos = 0;
+    var varint = function() {
+        var v = 0, scale = 1, c;
+        do {
+            if (pos >= b.length) throw new Error("truncated payload");
+            c = b[pos++];
+            v += (c & 0x7f) * scale;
+            scale *= 0x80;
+        } while (c & 0x80);
+        return v;
+    };
+    var unzigzag = function(v) { return v % 2 ? -(v + 1) / 2 : v / 2; };
+
+    if (b[pos++] != COL_VERSION) {
+        throw new Error("unknown accl_col version " + b[0]);
+    }
+    var n = varint();
+    var readings = [];
+    if (n == 0) return readings;
+
+    var ts = varint();
+    var acts = [];
+    for (var a = varint(); a > 0; a--) {
+        var len = varint();
+        acts.push(String.fromCharCode.apply(null, b.slice(pos, pos + len)));
+        pos += len;
+    }
+
+    var i;
+    for (i = 0; i < n; i++) {
+        if (i > 0) ts += unzigzag(varint());
+        readings.push({ ts: ts, x: 0, y: 0, z: 0, vib: false, act: "" });
+    }
+    ["x", "y", "z"].forEach(function(axis) {
+        var v = 0;
+        for (var i = 0; i < n; i++) {
+            v += unzigzag(varint());
+            readings[i][axis] = v;
+        }
+    });
+
+    var vib = false;
+    for (i = 0; i < n; vib = !vib) {
+        for (var run = varint(); run > 0; run--) readings[i++].vib = vib;
+    }
+    for (i = 0; i < n;) {
+        var act = acts[varint()];
+        for (var run = varint(); run > 0; run--) readings[i++].act = act;
+    }
+    return readings;
+}
+
+// feature windows from a parsed form body, or null if it has none
+function decodeFeatures(q) {
+    return q.feat ? JSON.parse(decodeURIComponent(q.feat)) : null;
+}
+
+// readings from a parsed form body, whichever format it carries
+function decodeUpload(q) {
+    if (q.accl_col) return decodeColumns(q.accl_col);
+    if (q.accl) return JSON.parse(decodeURIComponent(q.accl));
+    return null;
+}
+
+function parseForm(body) {
+    var q = {};
+    body.split("&").forEach(function(kv) {
+        var i = kv.indexOf("=");
+        q[kv.slice(0, i)] = kv.slice(i + 1);
+    });
+    return q;
+}
+
+module.exports = {
+    decodeColumns: decodeColumns,
+    decodeUpload: decodeUpload,
+    decodeFeatures: decodeFeatures,
+    parseForm: parseForm
+};